@@ -1,152 +1,185 @@
 #include <err.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
-#include <inttypes.h>
-#include <errno.h>
-#include <assert.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "pbm.h"
 
 // https://netpbm.sourceforge.net/doc/pbm.html
 
-char* load_text(const char* path, size_t* size) {
-	int file = open(path, O_RDONLY);
-	if (file == -1)
-		err(1, "failed to open `%s`", path);
-
-	ssize_t file_size = lseek(file, 0, SEEK_END);
-	if (file_size == -1)
-		err(1, "failed to lseek to the end of `%s`", path);
-	if (lseek(file, 0, SEEK_SET) == -1)
-		err(1, "failed to lseek to the beginning of `%s`", path);
+// the whitespace of isspace() in the C locale without a call per character
+static inline bool is_space_pbm(unsigned char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
 
-	char* buffer = malloc(file_size + 1);
-	if (!buffer)
-		err(1, "failed to allocate buffer for `%s`", path);
-	ssize_t buffer_len = 0;
-
-	while (buffer_len < file_size) {
-		ssize_t r = read(file, buffer + buffer_len, file_size - buffer_len);
-		if (r == -1)
-			err(1, "failed to read `%s`", path);
-		if (r == 0)
-			errx(1, "file `%s` ended unexpectedly", path);
-		buffer_len += r;
+struct Parser {
+	const char* path;
+	const unsigned char* file;
+	size_t size;
+	size_t pos;
+};
+
+// comments are allowed only in the header,
+// but it won't hurt if they are skipped in the plain data too
+void skip_space_pbm(struct Parser* parser) {
+	while (parser->pos < parser->size) {
+		unsigned char c = parser->file[parser->pos];
+		if (c == '#')
+			while (parser->pos < parser->size
+					&& parser->file[parser->pos] != '\n' && parser->file[parser->pos] != '\r')
+				parser->pos++;
+		else if (is_space_pbm(c))
+			parser->pos++;
+		else
+			break;
 	}
-	
-	if (close(file) == -1)
-		err(1, "failed to close `%s`", path);
-
-	*size = file_size + 1;
-	buffer[file_size] = '\0';
-	return buffer;
 }
 
-// comments are allowed only in the header
-// but it won't hurt if we remove them from the whole file
-void clear_pbm(char* file, size_t* file_size) {
-	size_t clean = 0;
-	for (;;) {
-		size_t start;
-		for (start = clean; start < *file_size; start++)
-			if (file[start] == '#')
-				break;
-		if (start == *file_size)
-			return;
-
-		size_t stop;
-		for (stop = start; stop < *file_size; stop++)
-			if (file[stop] == '\r' || file[stop] == '\n')
-				break;
-		// if invalid comment is after the end of the data section
-		// it's fine, otherwise it will fail in the further parsing
-		if (start == *file_size)
-			return;
-
-		size_t offset = stop - start;
-		memmove(file + start, file + start + offset, *file_size - start - offset);
-
-		clean = start;
+size_t parse_size_pbm(struct Parser* parser) {
+	skip_space_pbm(parser);
+	size_t value = 0, start = parser->pos;
+	for (; parser->pos < parser->size && isdigit(parser->file[parser->pos]); parser->pos++) {
+		size_t digit = parser->file[parser->pos] - '0';
+		if (value > (SIZE_MAX - digit) / 10)
+			errx(1, "size in the header of `%s` is too large", parser->path);
+		value = value * 10 + digit;
 	}
+	if (parser->pos == start || value == 0)
+		errx(1, "failed to parse header of `%s`", parser->path);
+	return value;
 }
 
-bool parse_pbm_header(char* file, size_t* file_size, size_t* width, size_t* height) {
-	clear_pbm(file, file_size);
-
-	if (*file_size < 2 || strncmp(file, "P1", 2))
-		return false;
-
-	char* start = file + 2;
-	char* end;
-	size_t* vars[] = { width, height };
-	for (size_t i = 0; i < sizeof(vars) / sizeof(*vars); i++) {
-		errno = 0;
-		uintmax_t val = strtoumax(start, &end, 10);
-		if (start == end || val == 0 ||  errno != 0) 
-			return false;
-		
-		*vars[i] = val;
-		start = end;
+// lit pixels are white, which is 0 in both formats,
+// the digits may be separated by whitespace and comments or not at all
+void parse_plain_pbm(struct Parser* parser, struct Bitmap* bitmap) {
+	size_t x = 0, y = 0;
+	unsigned char byte = 0;
+	unsigned char* row = bitmap->buff;
+	for (; parser->pos < parser->size && y < bitmap->height; parser->pos++) {
+		unsigned char c = parser->file[parser->pos];
+		if (c == '0' || c == '1') {
+			byte |= (c == '0') << (7 - x % 8);
+			x++;
+			if (x % 8 == 0 || x == bitmap->width) {
+				row[(x - 1) / 8] = byte;
+				byte = 0;
+			}
+			if (x == bitmap->width) {
+				x = 0;
+				y++;
+				row += bitmap->stride;
+			}
+		} else if (c == '#') {
+			skip_space_pbm(parser);
+			parser->pos--;
+		} else if (!is_space_pbm(c)) {
+			errx(1, "failed to parse data of `%s`", parser->path);
+		}
 	}
+	if (y < bitmap->height)
+		errx(1, "file `%s` ended unexpectedly", parser->path);
+}
 
-	if (!*end && !isspace(*end))
-		return false;
-
-	size_t offset = end + 1 - file;
-	memmove(file, file + offset, *file_size - offset);
-	return true;
+// rows are already packed like in the bitmap, only the bits are inverted
+void parse_raw_pbm(struct Parser* parser, struct Bitmap* bitmap) {
+	size_t size = bitmap->height * bitmap->stride;
+	if (parser->size - parser->pos < size)
+		errx(1, "file `%s` ended unexpectedly", parser->path);
+
+	const unsigned char* data = parser->file + parser->pos;
+	// bits past the width are padding
+	unsigned char last_mask = 0xFF << (8 - bitmap->width % 8) % 8;
+	for (size_t y = 0; y < bitmap->height; y++) {
+		unsigned char* row = bitmap->buff + y * bitmap->stride;
+		for (size_t i = 0; i < bitmap->stride; i++)
+			row[i] = ~data[y * bitmap->stride + i];
+		row[bitmap->stride - 1] &= last_mask;
+	}
+	parser->pos += size;
 }
 
-// NOTE leaks memory on fault by design
-// if it fails the program dies immediately
- const bool** parse_pbm_data(const char* file, size_t width, size_t height) {
-	bool** buffer = calloc(height, sizeof(bool*));
-	if (!buffer)
-		return NULL;
+// small files are read into the heap at once, larger ones are mapped,
+// which saves copying them, but costs more syscalls and page faults
+#define MAP_THRESHOLD (64 * 1024)
 
-	file--;
-	for (size_t y = 0; y < height; y++) {
-		buffer[y] = calloc(width, sizeof(bool));
-		if (!buffer[y])
-			return NULL;
+struct Bitmap load_pbm(const char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		err(1, "failed to open `%s`", path);
 
-		for (size_t x = 0; x < width; x++) {
-			while (isspace(*++file));
-
-			if (*file == '0')
-				buffer[y][x] = true;
-			else if (*file == '1')
-				buffer[y][x] = false;
-			else
-				return NULL;
+	struct stat st;
+	if (fstat(fd, &st))
+		err(1, "failed to stat `%s`", path);
+	if (st.st_size < 2)
+		errx(1, "failed to parse header of `%s`", path);
+
+	unsigned char* small = NULL;
+	const unsigned char* file;
+	bool mapped = st.st_size > MAP_THRESHOLD;
+	if (mapped) {
+		file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (file == MAP_FAILED)
+			err(1, "failed to map `%s`", path);
+	} else {
+		if (!(file = small = malloc(st.st_size)))
+			err(1, "failed to allocate buffer for `%s`", path);
+		for (ssize_t len = 0; len < st.st_size;) {
+			ssize_t r = read(fd, small + len, st.st_size - len);
+			if (r == -1)
+				err(1, "failed to read `%s`", path);
+			if (r == 0)
+				errx(1, "file `%s` ended unexpectedly", path);
+			len += r;
 		}
 	}
+	if (close(fd))
+		err(1, "failed to close `%s`", path);
 
-	return (const bool**)buffer;
-}
+	// the whole file is parsed in a single forward pass
+	struct Parser parser = { .path = path, .file = file, .size = st.st_size, .pos = 2 };
+	bool raw;
+	if (!memcmp(file, "P1", 2))
+		raw = false;
+	else if (!memcmp(file, "P4", 2))
+		raw = true;
+	else
+		errx(1, "failed to parse header of `%s`", path);
+
+	struct Bitmap bitmap;
+	bitmap.width = parse_size_pbm(&parser);
+	bitmap.height = parse_size_pbm(&parser);
+	bitmap.stride = (bitmap.width + 7) / 8;
+	if (bitmap.height > SIZE_MAX / bitmap.stride)
+		errx(1, "size in the header of `%s` is too large", path);
+
+	// a single whitespace separates the header from the data, a comment
+	// may come before it, the newline ending the comment is the whitespace
+	if (parser.pos < parser.size && file[parser.pos] == '#')
+		while (parser.pos < parser.size && file[parser.pos] != '\n' && file[parser.pos] != '\r')
+			parser.pos++;
+	if (parser.pos == parser.size || !is_space_pbm(file[parser.pos]))
+		errx(1, "failed to parse header of `%s`", path);
+	parser.pos++;
+
+	if (!(bitmap.buff = calloc(bitmap.height, bitmap.stride)))
+		err(1, "failed to allocate buffer for `%s`", path);
 
-struct Bitmap load_pbm(const char* path) {
-	size_t file_size;
-	char* file = load_text(path, &file_size);
-
-	size_t width, height;
-	if (!parse_pbm_header(file, &file_size, &width, &height))
-		errx(1, "failed to parse header od `%s`", path);
-
-	const bool** buffer = parse_pbm_data(file, width, height);
-	if (!buffer)
-		errx(1, "failed to parse data of `%s`", path);
-
-	free(file);
-	return (struct Bitmap) {
-		.buff = buffer,
-		.height = height,
-		.width = width
-	};
+	if (raw)
+		parse_raw_pbm(&parser, &bitmap);
+	else
+		parse_plain_pbm(&parser, &bitmap);
+
+	if (mapped && munmap((void*)file, st.st_size))
+		err(1, "failed to unmap `%s`", path);
+	free(small);
+	return bitmap;
 }
 
 struct Bitmap load_exp_pbm(const char* path, size_t exp_width, size_t exp_height) {
@@ -161,11 +194,40 @@ struct Bitmap load_exp_pbm(const char* path, size_t exp_width, size_t exp_height
 }
 
 void free_pbm(struct Bitmap* bitmap) {
-	for (size_t y = 0; y < bitmap->height; y++)
-		free((void*)bitmap->buff[y]);
 	free(bitmap->buff);
 	bitmap->buff = NULL;
-	bitmap->width=0;
-	bitmap->height=0;
+	bitmap->width = 0;
+	bitmap->height = 0;
+	bitmap->stride = 0;
+}
+
+void pack_pbm(const struct Bitmap* bitmap, unsigned char* packed) {
+	memset(packed, 0, PACKED_SIZE(bitmap->width, bitmap->height));
+	for (size_t y = 0; y < bitmap->height; y++)
+		for (size_t x = 0; x < bitmap->width; x++)
+			packed[y / 8 * bitmap->width + x] |= get_pbm(bitmap, x, y) << y % 8;
 }
 
+void save_frame_pbm(const char* path, const unsigned char* frame, size_t width, size_t height) {
+	size_t path_len = strlen(path);
+	char temp_path[path_len + sizeof(".tmp")];
+	memcpy(temp_path, path, path_len);
+	memcpy(temp_path + path_len, ".tmp", sizeof(".tmp"));
+
+	FILE* output = fopen(temp_path, "w");
+	if (!output)
+		err(1, "failed to open `%s`", temp_path);
+
+	fprintf(output, "P1\n%zu %zu\n", width, height);
+	for (size_t y = 0; y < height; y++)
+		for (size_t x = 0; x < width; x++) {
+			bool pixel = frame[y / 8 * width + x] >> y % 8 & 1;
+			fputc(pixel ? '0' : '1', output);
+			fputc(x == width - 1 ? '\n' : ' ', output);
+		}
+
+	if (ferror(output) | fclose(output))
+		err(1, "failed to write to `%s`", temp_path);
+	if (rename(temp_path, path))
+		err(1, "failed to rename `%s` to `%s`", temp_path, path);
+}
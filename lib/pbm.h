@@ -4,16 +4,36 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+// pixels packed a row after another, most significant bit first like in P4,
+// but lit pixels are set, bits past the width are clear
 struct Bitmap {
-	const bool** buff;
+	unsigned char* buff;
 	size_t width;
 	size_t height;
+	// bytes in a row
+	size_t stride;
 };
 
+static inline bool get_pbm(const struct Bitmap* bitmap, size_t x, size_t y) {
+	return bitmap->buff[y * bitmap->stride + x / 8] >> (7 - x % 8) & 1;
+}
+
+// reads plain P1 and raw P4 files, lit pixels are white, the program dies on failure
 struct Bitmap load_pbm(const char* path);
 
 struct Bitmap load_exp_pbm(const char* path, size_t exp_width, size_t exp_height);
 
 void free_pbm(struct Bitmap* bitmap);
 
+// bytes taken by the bitmap in the ssd1306 page-major layout
+#define PACKED_SIZE(width, height) (((height) + 7) / 8 * (width))
+
+// packs the bitmap in the page-major layout, lit pixels are set,
+// rows past the bitmap in its last page are cleared
+void pack_pbm(const struct Bitmap* bitmap, unsigned char* packed);
+
+// writes a frame packed in the ssd1306 page-major layout, lit pixels are white
+// like in the loaded bitmaps, the file is replaced at once
+void save_frame_pbm(const char* path, const unsigned char* frame, size_t width, size_t height);
+
 #endif
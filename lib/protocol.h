@@ -0,0 +1,34 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// shared by the host and the board, every command is a single byte
+// followed by its arguments
+
+#define DISPLAY_WIDTH 128
+#define DISPLAY_PAGES 8
+
+// bytes per second the board passes to the display, 9 clocks a byte at 888 kHz,
+// less the start, the stop and the window commands, see init_twi(),
+// bytes received faster than it are kept in the receive buffer
+#define TWI_RATE 90000
+
+// writes a window of the display memory:
+// first column, last column, first page, last page, followed by
+// (last column - first column + 1) * (last page - first page + 1) bytes
+// in the ssd1306 horizontal addressing order
+#define CMD_WINDOW 'w'
+
+// same as CMD_WINDOW, but the data is encoded as described in rle.h
+// and is decoded by the board on the fly
+#define CMD_WINDOW_RLE 'r'
+
+// asks the board what it supports, it answers with a line
+// "hello <receive buffer size> <codecs>...", e.g. "hello 255 rle"
+#define CMD_HELLO 'h'
+
+// ends a frame, sent even when nothing has changed to keep the watchdog happy,
+// when the receive buffer got fuller than ever before, the board answers
+// with a line "rx_max <bytes>", any other line is an error it stopped on
+#define CMD_FRAME 'f'
+
+#endif
@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "rle.h"
+
+size_t encode_rle(unsigned char* dst, const unsigned char* src, size_t len) {
+	size_t size = 0;
+	size_t literal = 0; // start of pending literal bytes
+
+	for (size_t i = 0; i < len;) {
+		size_t run = 1;
+		while (i + run < len && run < RLE_MAX_RUN && src[i + run] == src[i])
+			run++;
+
+		// a run of two is only worth it if it doesn't split literals
+		if (run < 3 && !(run == 2 && literal == i)) {
+			i += run;
+			continue;
+		}
+
+		while (literal < i) {
+			size_t n = i - literal < RLE_MAX_RUN ? i - literal : RLE_MAX_RUN;
+			dst[size++] = n - 1;
+			memcpy(dst + size, src + literal, n);
+			size += n;
+			literal += n;
+		}
+
+		dst[size++] = 0x80 | (run - 1);
+		dst[size++] = src[i];
+		i += run;
+		literal = i;
+	}
+
+	while (literal < len) {
+		size_t n = len - literal < RLE_MAX_RUN ? len - literal : RLE_MAX_RUN;
+		dst[size++] = n - 1;
+		memcpy(dst + size, src + literal, n);
+		size += n;
+		literal += n;
+	}
+
+	return size;
+}
+
+size_t decode_rle(unsigned char* dst, size_t len, const unsigned char* src, size_t src_len) {
+	size_t consumed = 0;
+	while (len) {
+		if (consumed == src_len)
+			return 0;
+		unsigned char control = src[consumed++];
+		size_t n = (control & 0x7F) + 1;
+		if (n > len)
+			return 0;
+
+		if (control & 0x80) {
+			if (consumed == src_len)
+				return 0;
+			memset(dst, src[consumed++], n);
+		} else {
+			if (src_len - consumed < n)
+				return 0;
+			memcpy(dst, src + consumed, n);
+			consumed += n;
+		}
+		dst += n;
+		len -= n;
+	}
+	return consumed;
+}
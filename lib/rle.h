@@ -0,0 +1,21 @@
+#ifndef RLE_H
+#define RLE_H
+
+#include <stddef.h>
+
+// every run starts with a control byte n:
+// 0x00..0x7F - n + 1 literal bytes follow
+// 0x80..0xFF - the following byte is repeated (n & 0x7F) + 1 times
+#define RLE_MAX_RUN 128
+
+// maximum size of encoded data of length len
+#define RLE_BOUND(len) ((len) + ((len) + RLE_MAX_RUN - 1) / RLE_MAX_RUN)
+
+// dst must hold at least RLE_BOUND(len) bytes, returns encoded size
+size_t encode_rle(unsigned char* dst, const unsigned char* src, size_t len);
+
+// decodes exactly len bytes, returns number of bytes consumed from src
+// or 0 if src is invalid or too short
+size_t decode_rle(unsigned char* dst, size_t len, const unsigned char* src, size_t src_len);
+
+#endif
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <stdbool.h>
@@ -6,29 +7,25 @@
 #include "area.h"
 
 void alloc_area(struct Area* area, size_t width, size_t height){
-	if (!(area->buff = calloc(height, sizeof(bool*))))
+	assert(height % 8 == 0);
+	if (!(area->buff = calloc(height / 8 * width, 1)))
 		err(1, "failed to allocate memory for area");
 
-	for (size_t y = 0; y < height; y++)
-		if (!(area->buff[y] = calloc(width, sizeof(bool))))
-			err(1, "failed to allocate memory for area");
-
+	area->stride = width;
 	area->width = width;
 	area->height = height;
 	area->x_offset = 0;
 	area->y_offset = 0;
 }
 
-void set_area(struct Area* area, size_t x, size_t y, bool value) {
-	assert(x < area->width - area->x_offset);
-	assert(y < area->height - area->y_offset);
-	area->buff[area->y_offset + y][area->x_offset + x] = value;
-}
-
-bool get_area(const struct Area* area, size_t x, size_t y) {
-	assert(x < area->width - area->x_offset);
-	assert(y < area->height - area->y_offset);
-	return area->buff[area->y_offset + y][area->x_offset + x];
+void init_area(struct Area* area, unsigned char* buff, size_t width, size_t height) {
+	assert(height % 8 == 0);
+	area->buff = buff;
+	area->stride = width;
+	area->width = width;
+	area->height = height;
+	area->x_offset = 0;
+	area->y_offset = 0;
 }
 
 void subarea(
@@ -43,14 +40,58 @@ void subarea(
 	assert(y_offset + height <= area->height);
 
 	subarea->buff = area->buff;
+	subarea->stride = area->stride;
 	subarea->x_offset = area->x_offset + x_offset;
 	subarea->y_offset = area->y_offset + y_offset;
 	subarea->width = width;
 	subarea->height = height;
 }
 
+void fill_area(struct Area* area, bool value) {
+	size_t top = area->y_offset;
+	size_t bottom = area->y_offset + area->height;
+	if (top == bottom)
+		return;
+
+	for (size_t page = top / 8; page * 8 < bottom; page++) {
+		// bits of this page covered by the area
+		unsigned mask = 0xFF;
+		if (page == top / 8)
+			mask &= 0xFF << top % 8;
+		if (page == (bottom - 1) / 8)
+			mask &= 0xFF >> (7 - (bottom - 1) % 8);
+
+		unsigned char* row = area->buff + page * area->stride + area->x_offset;
+		if (value)
+			for (size_t x = 0; x < area->width; x++)
+				row[x] |= mask;
+		else
+			for (size_t x = 0; x < area->width; x++)
+				row[x] &= ~mask;
+	}
+}
+
 void clear_area(struct Area* area) {
-	for (size_t y = 0; y < area->height; y++)
-		for (size_t x = 0; x < area->width; x++)
-			set_area(area, x, y, false);
+	fill_area(area, false);
+}
+
+void reset_damage(struct Damage* damage, size_t pages) {
+	for (size_t page = 0; page < pages; page++) {
+		damage[page].first = SIZE_MAX;
+		damage[page].last = 0;
+	}
+}
+
+void damage_area(const struct Area* area, struct Damage* damage) {
+	if (!area->width || !area->height)
+		return;
+
+	size_t first = area->x_offset, last = area->x_offset + area->width - 1;
+	size_t bottom = area->y_offset + area->height;
+	for (size_t page = area->y_offset / 8; page * 8 < bottom; page++) {
+		if (first < damage[page].first)
+			damage[page].first = first;
+		if (last > damage[page].last)
+			damage[page].last = last;
+	}
 }
@@ -3,22 +3,47 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <assert.h>
 
+// pixels are packed in the ssd1306 page-major layout:
+// every byte is a column of 8 vertical pixels, least significant bit on top,
+// and each page of 8 rows takes `stride` consecutive bytes
 struct Area {
-	bool** buff;
+	unsigned char* buff;
+	size_t stride;
 	size_t width;
 	size_t height;
 	size_t x_offset;
 	size_t y_offset;
 };
 
+// height must be a multiple of 8
 void alloc_area(struct Area* area, size_t width, size_t height);
 
+// same as alloc_area() on memory owned by someone else, it isn't cleared
+void init_area(struct Area* area, unsigned char* buff, size_t width, size_t height);
+
 // since the program will never stop and free it's resources, there is no free_area()
 
-void set_area(struct Area* area, size_t x, size_t y, bool value);
+static inline void set_area(struct Area* area, size_t x, size_t y, bool value) {
+	assert(x < area->width);
+	assert(y < area->height);
+	x += area->x_offset;
+	y += area->y_offset;
+	unsigned char* byte = area->buff + y / 8 * area->stride + x;
+	if (value)
+		*byte |= 1 << y % 8;
+	else
+		*byte &= ~(1 << y % 8);
+}
 
-bool get_area(const struct Area* area, size_t x, size_t y);
+static inline bool get_area(const struct Area* area, size_t x, size_t y) {
+	assert(x < area->width);
+	assert(y < area->height);
+	x += area->x_offset;
+	y += area->y_offset;
+	return area->buff[y / 8 * area->stride + x] >> y % 8 & 1;
+}
 
 void subarea(
 		const struct Area*  area, 
@@ -29,6 +54,21 @@ void subarea(
 		size_t height
 );
 
+// sets or clears every pixel of the area a byte column at a time
+void fill_area(struct Area* area, bool value);
+
 void clear_area(struct Area* area);
 
+// the columns of a page, that were drawn to, first > last if none were
+struct Damage {
+	size_t first;
+	size_t last;
+};
+
+// damage has an element per page of the buffer
+void reset_damage(struct Damage* damage, size_t pages);
+
+// adds the columns of the area to every page it covers
+void damage_area(const struct Area* area, struct Damage* damage);
+
 #endif
@@ -0,0 +1,28 @@
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+void* alloc_arena(struct Arena* arena, size_t count, size_t size) {
+	if (!arena) {
+		void* memory = calloc(count, size);
+		if (!memory)
+			err(1, "failed to allocate memory");
+		return memory;
+	}
+
+	void* memory = take_arena(arena, count, size);
+	memset(memory, 0, ARENA_SIZE(count, size));
+	return memory;
+}
+
+void* take_arena(struct Arena* arena, size_t count, size_t size) {
+	size_t taken = ARENA_SIZE(count, size);
+	if (taken > arena->size - arena->used)
+		errx(1, "arena of %zu bytes is exhausted", arena->size);
+
+	void* memory = arena->buff + arena->used;
+	arena->used += taken;
+	return memory;
+}
@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// memory handed out in order from a fixed buffer,
+// the same sequence of allocations always gets the same addresses
+struct Arena {
+	char* buff;
+	size_t size;
+	size_t used;
+};
+
+#define ARENA_ALIGN 16
+
+// space taken by an allocation of count elements of size
+#define ARENA_SIZE(count, size) \
+	(((count) * (size) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+
+// with NULL arena the memory is calloc'd, it's zeroed either way
+void* alloc_arena(struct Arena* arena, size_t count, size_t size);
+
+// same as alloc_arena, but the memory is left as it is,
+// for arenas over memory that was filled by a previous run
+void* take_arena(struct Arena* arena, size_t count, size_t size);
+
+#endif
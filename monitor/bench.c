@@ -0,0 +1,761 @@
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+#include "render.h"
+#include "screen.h"
+#include "display.h"
+#include "timing.h"
+#include "source.h"
+#include "stats.h"
+#include "scan.h"
+#include "hwmon.h"
+#include "links.h"
+
+#define FRAMES 600
+// every case is timed in repetitions of about REPETITION_TIME seconds,
+// after warming up for as long as it takes to find their size
+#define REPETITIONS 101
+#define REPETITION_TIME 0.002
+
+// every allocation goes through these, so it's counted for allocs/op
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+size_t allocations;
+
+void* malloc(size_t size) {
+	allocations++;
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+	allocations++;
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+	allocations++;
+	return __libc_realloc(ptr, size);
+}
+
+// frames are rendered with the layout of main.c from a random walk,
+// that changes about as much as the real statistics do
+void render_frames(unsigned char (*frames)[1024], size_t count) {
+	struct Area area;
+	alloc_area(&area, 128, 64);
+	render_template(&area);
+
+	const size_t plot_offsets[][2] = {
+		{ 0, 0 }, { 0, 12 }, { 0, 42 }, { 0, 54 },
+		{ 90, 0 }, { 90, 12 }, { 90, 42 }, { 90, 54 },
+	};
+	const size_t scalar_offsets[][2] = {
+		{ 53, 0 }, { 53, 18 }, { 53, 42 }, { 53, 60 },
+	};
+
+	struct Area plots[8];
+	struct Ring rings[8];
+	double walk[8] = {};
+	for (size_t i = 0; i < 8; i++) {
+		subarea(&area, plots + i, plot_offsets[i][0], plot_offsets[i][1], PLOT_WIDTH, PLOT_HEIGHT);
+		alloc_ring(rings + i, PLOT_WIDTH);
+	}
+
+	struct Area scalars[4];
+	for (size_t i = 0; i < 4; i++)
+		subarea(&area, scalars + i, scalar_offsets[i][0], scalar_offsets[i][1], 33, 4);
+
+	srand(1);
+	for (size_t f = 0; f < count; f++) {
+		for (size_t i = 0; i < 8; i++) {
+			walk[i] += (rand() / (double)RAND_MAX - 0.5) / 4;
+			if (walk[i] < 0)
+				walk[i] = 0;
+			if (walk[i] > 1)
+				walk[i] = 1;
+			push_ring(rings + i, walk[i]);
+			render_plot(plots + i, rings + i);
+		}
+		for (size_t i = 0; i < 4; i++)
+			render_scalar_prefixed(scalars + i, walk[i + 4] * 1e8);
+
+		memcpy(frames[f], area.buff, 1024);
+	}
+}
+
+void check_rle(const unsigned char* data, size_t len) {
+	unsigned char encoded[RLE_BOUND(len)];
+	unsigned char decoded[len];
+	size_t encoded_len = encode_rle(encoded, data, len);
+	if (encoded_len > RLE_BOUND(len))
+		errx(1, "rle encoded %zu bytes into %zu", len, encoded_len);
+	if (decode_rle(decoded, len, encoded, encoded_len) != encoded_len)
+		errx(1, "rle failed to decode %zu bytes", len);
+	if (memcmp(data, decoded, len))
+		errx(1, "rle round trip of %zu bytes differs", len);
+}
+
+void bench_codec(unsigned char (*frames)[1024], size_t count) {
+	for (size_t f = 0; f < count; f++)
+		for (size_t page = 0; page < DISPLAY_PAGES; page++)
+			check_rle(frames[f] + page * DISPLAY_WIDTH, DISPLAY_WIDTH);
+
+	unsigned char noise[1024];
+	for (size_t len = 1; len <= sizeof(noise); len++) {
+		for (size_t i = 0; i < len; i++)
+			noise[i] = rand() % (len % 4 + 1) ? 0xFF : rand();
+		check_rle(noise, len);
+	}
+
+	const struct {
+		const char* name;
+		enum Codec codec;
+		size_t rx_size;
+		bool delta;
+	} modes[] = {
+		{ "full raw", CODEC_RAW, 0, false },
+		{ "delta raw", CODEC_RAW, 0, true },
+		{ "delta rle", CODEC_RLE, 255, true },
+		{ "delta rle unbounded", CODEC_RLE, SIZE_MAX, true },
+	};
+
+	for (size_t m = 0; m < sizeof(modes) / sizeof(*modes); m++) {
+		struct Display display = {
+			.fd = -1,
+			.codec = modes[m].codec,
+			.rx_size = modes[m].rx_size,
+		};
+		unsigned char packet[PACKET_SIZE];
+		size_t total = 0, worst = 0;
+
+		for (size_t f = 0; f < count; f++) {
+			display.synced = modes[m].delta && f;
+			size_t len = pack_display(&display, packet, frames[f], NULL);
+			total += len;
+			if (len > worst)
+				worst = len;
+		}
+
+		printf(
+			"%-20s %7.1f bytes/frame, %4zu worst\n",
+			modes[m].name, (double)total / count, worst
+		);
+	}
+}
+
+// the way stats.c used to read files
+void rewind_or_die(const char* path, FILE** file) {
+	if (!*file) {
+		*file = fopen(path, "r");
+		if (!*file)
+			err(1, "failed to open `%s`", path);
+	} else {
+		if (fflush(*file) == EOF)
+			err(1, "failed to flush `%s`", path);
+		rewind(*file);
+	}
+}
+
+double sample_stdio() {
+	static FILE *stat, *meminfo, *uptime;
+	unsigned long long cpu[10], mem[2];
+	double time;
+
+	rewind_or_die("/proc/stat", &stat);
+	if (fscanf(
+		stat, "cpu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+		cpu, cpu + 1, cpu + 2, cpu + 3, cpu + 4, cpu + 5, cpu + 6, cpu + 7, cpu + 8, cpu + 9
+	) != 10)
+		errx(1, "failed to parse `/proc/stat`");
+
+	rewind_or_die("/proc/meminfo", &meminfo);
+	if (fscanf(
+		meminfo, "MemTotal: %llu kB MemFree: %*u kB MemAvailable: %llu kB", mem, mem + 1
+	) != 2)
+		errx(1, "failed to parse `/proc/meminfo`");
+
+	rewind_or_die("/proc/uptime", &uptime);
+	if (fscanf(uptime, "%lf", &time) != 1)
+		errx(1, "failed to parse `/proc/uptime`");
+
+	return cpu[0] + mem[1] + time;
+}
+
+static char stat_buff[256], meminfo_buff[256], uptime_buff[64];
+static struct Source stat = SOURCE("/proc/stat", stat_buff);
+static struct Source meminfo = SOURCE("/proc/meminfo", meminfo_buff);
+static struct Source uptime = SOURCE("/proc/uptime", uptime_buff);
+static struct Source* sources[] = { &stat, &meminfo, &uptime };
+
+double parse_sources() {
+	unsigned long long busy, total, mem_total, mem_available;
+	double time;
+
+	if (!parse_cpu(stat.buff, &busy, &total))
+		errx(1, "failed to parse `/proc/stat`");
+
+	if (!parse_meminfo(meminfo.buff, &mem_total, &mem_available))
+		errx(1, "failed to parse `/proc/meminfo`");
+
+	const char* text = uptime.buff;
+	if (!scan_decimal(&text, &time))
+		errx(1, "failed to parse `/proc/uptime`");
+
+	return busy + mem_available + time;
+}
+
+double sample_pread() {
+	static struct Batch batch;
+	if (!batch.sources)
+		init_batch(&batch, sources, sizeof(sources) / sizeof(*sources), false);
+	read_batch(&batch);
+	return parse_sources();
+}
+
+double sample_uring() {
+	static struct Batch batch;
+	if (!batch.sources) {
+		init_batch(&batch, sources, sizeof(sources) / sizeof(*sources), true);
+		if (!batch.uring)
+			warnx("io_uring is unavailable, falling back to pread");
+	}
+	read_batch(&batch);
+	return parse_sources();
+}
+
+// the way stats.c used to read a single interface, for every one of them
+double sample_net_sysfs() {
+	static char names_buff[4096];
+	static struct Source* net_sources;
+	static size_t net_count;
+	static struct Batch batch;
+	if (!batch.sources) {
+		struct Source names = SOURCE("/sys/class/net", names_buff);
+		list_source(&names);
+		for (const char* c = names_buff; *c; c++)
+			net_count += *c == '\n';
+		net_count *= 2;
+		if (!(net_sources = calloc(net_count, sizeof(struct Source))))
+			err(1, "failed to allocate memory for sources");
+
+		struct Source** pointers = malloc(net_count * sizeof(struct Source*));
+		if (!pointers)
+			err(1, "failed to allocate memory for sources");
+		size_t i = 0;
+		for (const char* name = names_buff; *name; i += 2) {
+			size_t length = strcspn(name, "\n");
+			for (size_t s = 0; s < 2; s++) {
+				char path[128];
+				snprintf(path, sizeof(path), "/sys/class/net/%.*s/statistics/%s_bytes", (int)length, name, s ? "tx" : "rx");
+				net_sources[i + s] = (struct Source) {
+					.path = strdup(path), .fd = -1, .buff = malloc(32), .size = 32,
+				};
+				if (!net_sources[i + s].path || !net_sources[i + s].buff)
+					err(1, "failed to allocate memory for sources");
+				pointers[i + s] = net_sources + i + s;
+			}
+			name += length + 1;
+		}
+		init_batch(&batch, pointers, net_count, false);
+	}
+
+	read_batch(&batch);
+	double sum = 0;
+	for (size_t i = 0; i < net_count; i++) {
+		const char* text = net_sources[i].buff;
+		unsigned long long value;
+		if (!scan_u64(&text, &value))
+			errx(1, "failed to parse `%s`", net_sources[i].path);
+		sum += value;
+	}
+	return sum;
+}
+
+double sample_net_rtnetlink() {
+	static struct Links links;
+	static bool initialized;
+	if (!initialized) {
+		init_links(&links);
+		initialized = true;
+	}
+	update_links(&links);
+	return links.rx + links.tx;
+}
+
+// the cases run on these, set up by init_fixtures()
+unsigned char (*frames)[1024];
+struct Area screen;
+struct Area plot_area, scalar_area, prefixed_area, heatmap_area;
+struct Ring rings[8];
+double heatmap_values[16];
+struct Display packing;
+// the layout of the monitor, drawn from stats that change every sample or never
+struct Screen layout_screen;
+struct Stats screen_stats;
+
+const char stat_fixture[] =
+	"cpu  4705 150 1120 16250 520 0 25 0 0 0\n"
+	"cpu0 1393 33 281 3861 121 0 19 0 0 0\n"
+	"cpu1 1098 40 280 4190 126 0 4 0 0 0\n"
+	"cpu2 1123 38 279 4079 136 0 1 0 0 0\n"
+	"cpu3 1091 39 280 4120 137 0 1 0 0 0\n"
+	"intr 114930548 113199788 3 0 5 263 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n"
+	"ctxt 1990473\n"
+	"btime 1062191376\n"
+	"processes 2915\n"
+	"procs_running 1\n"
+	"procs_blocked 0\n"
+	"softirq 183433 0 21755 12 39 0 0 0 0 0 161627\n";
+
+const char meminfo_fixture[] =
+	"MemTotal:       16307456 kB\n"
+	"MemFree:         6417144 kB\n"
+	"MemAvailable:   11829836 kB\n"
+	"Buffers:          296572 kB\n"
+	"Cached:          5259876 kB\n";
+
+const char disk_fixture[] =
+	"  226012    58104 14936170    62893   268385   254917 14620418   380213        0   280688   487093\n";
+
+const char uptime_fixture[] = "350735.47 234388.90\n";
+
+// a found temp1_input of k10temp, set up by init_fixtures()
+struct Sensor sensor_fixture = { .device = "k10temp", .input = "temp1_input" };
+
+// a RTM_GETSTATS dump of as many interfaces as a busy host has,
+// written by write_links_fixture()
+#define LINKS_FIXTURE 16
+struct StatsMessage {
+	struct nlmsghdr header;
+	struct if_stats_msg message;
+	struct rtattr attr;
+	struct rtnl_link_stats64 counters;
+};
+struct StatsMessage links_fixture[LINKS_FIXTURE + 1];
+struct Links parsed_links;
+
+// the links fixture sent as a dump of DUMP_FIXTURE messages over a socket pair
+// standing in for netlink, which overflow dump_buff, the last one ends the dump
+#define DUMP_FIXTURE 4
+int dump_pair[2];
+struct Links dumping_links;
+char dump_buff[8 * 1024];
+
+// the template in the raw format, written by init_fixtures()
+char template_p4_path[] = "/tmp/bench_monitor_XXXXXX";
+
+void write_template_p4() {
+	int fd = mkstemp(template_p4_path);
+	if (fd == -1)
+		err(1, "failed to create `%s`", template_p4_path);
+	FILE* output = fdopen(fd, "w");
+	if (!output)
+		err(1, "failed to open `%s`", template_p4_path);
+
+	// P4 has the bits of the bitmap inverted
+	struct Bitmap template = load_pbm("../bitmaps/template.pbm");
+	fprintf(output, "P4\n%zu %zu\n", template.width, template.height);
+	for (size_t i = 0; i < template.height * template.stride; i++)
+		fputc(~template.buff[i] & 0xFF, output);
+	free_pbm(&template);
+
+	if (ferror(output) | fclose(output))
+		err(1, "failed to write to `%s`", template_p4_path);
+}
+
+// the messages are aligned as they are, so they follow each other like in a dump,
+// the interfaces come in the order of the kernel's hash table
+void write_links_fixture() {
+	for (size_t i = 0; i < LINKS_FIXTURE; i++)
+		links_fixture[i] = (struct StatsMessage) {
+			.header = { .nlmsg_len = sizeof(struct StatsMessage), .nlmsg_type = RTM_NEWSTATS },
+			.message = { .ifindex = (i * 7) % LINKS_FIXTURE + 1 },
+			.attr = { .rta_len = RTA_LENGTH(sizeof(struct rtnl_link_stats64)), .rta_type = IFLA_STATS_LINK_64 },
+			.counters = { .rx_bytes = 1000000 * i, .tx_bytes = 300000 * i },
+		};
+	links_fixture[LINKS_FIXTURE].header = (struct nlmsghdr) { .nlmsg_len = NLMSG_LENGTH(0), .nlmsg_type = NLMSG_DONE };
+	init_links(&parsed_links);
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, dump_pair))
+		err(1, "failed to create a socket pair");
+	init_links(&dumping_links);
+	dumping_links.fd = dump_pair[0];
+}
+
+void init_fixtures() {
+	write_template_p4();
+	write_links_fixture();
+
+	sensor_fixture.source = (struct Source)SOURCE("/sys/class/hwmon/hwmon2/temp1_input", sensor_fixture.buff);
+	strcpy(sensor_fixture.buff, "45250\n");
+
+	static unsigned char rendered[FRAMES][1024];
+	frames = rendered;
+	render_frames(frames, FRAMES);
+
+	alloc_area(&screen, 128, 64);
+	subarea(&screen, &plot_area, 0, 0, PLOT_WIDTH, PLOT_HEIGHT);
+	subarea(&screen, &scalar_area, 49, 6, 11, 4);
+	subarea(&screen, &prefixed_area, 53, 0, 33, 4);
+	subarea(&screen, &heatmap_area, 0, 22, 128, 3);
+
+	srand(2);
+	for (size_t r = 0; r < 8; r++) {
+		alloc_tracked_ring(rings + r, PLOT_WIDTH);
+		for (size_t i = 0; i < PLOT_WIDTH; i++)
+			push_ring(rings + r, rand() / (double)RAND_MAX);
+	}
+	for (size_t i = 0; i < 16; i++)
+		heatmap_values[i] = rand() / (double)RAND_MAX;
+
+	packing.fd = -1;
+	packing.rx_size = 255;
+
+	init_screen(&layout_screen, NULL, 1, RESOLUTION_SAMPLE, CONSOLIDATION_MEAN);
+	add_view_screen(&layout_screen, VIEW_OVERVIEW, NULL);
+	screen_stats.cores = 16;
+	for (size_t i = 0; i < screen_stats.cores; i++)
+		screen_stats.core_usage[i] = screen_stats.core_freq[i] = heatmap_values[i];
+	for (size_t i = 0; i < PLOT_WIDTH; i++)
+		push_screen(&layout_screen, &screen_stats);
+	render_screen(&layout_screen, &screen_stats);
+}
+
+void run_render_plot(size_t i) {
+	render_plot(&plot_area, rings + i % 8);
+}
+
+void run_render_plot_norm(size_t i) {
+	render_plot_norm(&plot_area, rings + i % 8);
+}
+
+void run_render_plot_fluct(size_t i) {
+	render_plot_fluct(&plot_area, rings + i % 8);
+}
+
+void run_render_plot_line(size_t i) {
+	render_plot_styled(&plot_area, rings + i % 8, NULL, PLOT_NORM, PLOT_LINE);
+}
+
+void run_render_plot_envelope(size_t i) {
+	render_plot_styled(&plot_area, rings + i % 8, rings + (i + 1) % 8, PLOT_FLUCT, PLOT_ENVELOPE);
+}
+
+void run_render_scalar(size_t i) {
+	render_scalar(&scalar_area, i % 1000);
+}
+
+void run_render_scalar_prefixed(size_t i) {
+	render_scalar_prefixed(&prefixed_area, (i * 2654435761u) % (1ull << 40));
+}
+
+void run_render_heatmap(size_t i) {
+	heatmap_values[i % 16] = i % 101 / 100.0;
+	render_heatmap(&heatmap_area, heatmap_values, 16);
+}
+
+void run_render_screen_steady(size_t i) {
+	(void)i;
+	render_screen(&layout_screen, &screen_stats);
+}
+
+void run_render_screen_sampled(size_t i) {
+	double walk = i % 101 / 100.0;
+	screen_stats.cpu = screen_stats.ram = walk;
+	screen_stats.cpu_tmp = screen_stats.ram_tmp = 40 + walk * 20;
+	screen_stats.net_rx = screen_stats.net_tx = walk * 1e8;
+	screen_stats.disk_r = screen_stats.disk_w = walk * 1e9;
+	screen_stats.fan1 = screen_stats.fan2 = screen_stats.fan3 = 800 + walk * 1000;
+	screen_stats.core_usage[i % 16] = walk;
+	push_screen(&layout_screen, &screen_stats);
+	render_screen(&layout_screen, &screen_stats);
+}
+
+void run_pack(size_t i, enum Codec codec, bool delta) {
+	unsigned char packet[PACKET_SIZE];
+	packing.codec = codec;
+	packing.synced = delta;
+	volatile size_t len = pack_display(&packing, packet, frames[i % FRAMES], NULL);
+	(void)len;
+}
+
+void run_pack_full_raw(size_t i) {
+	run_pack(i, CODEC_RAW, false);
+}
+
+void run_pack_delta_raw(size_t i) {
+	run_pack(i, CODEC_RAW, true);
+}
+
+void run_pack_delta_rle(size_t i) {
+	run_pack(i, CODEC_RLE, true);
+}
+
+void run_parse_cpu(size_t i) {
+	(void)i;
+	unsigned long long busy, total;
+	if (!parse_cpu(stat_fixture, &busy, &total))
+		errx(1, "failed to parse the stat fixture");
+}
+
+void run_parse_cores(size_t i) {
+	(void)i;
+	const unsigned ids[] = { 0, 1, 2, 3 };
+	unsigned long long busy[4], total[4];
+	if (!parse_cores(stat_fixture, ids, busy, total, 4))
+		errx(1, "failed to parse the stat fixture");
+}
+
+void run_parse_meminfo(size_t i) {
+	(void)i;
+	unsigned long long total, available;
+	if (!parse_meminfo(meminfo_fixture, &total, &available))
+		errx(1, "failed to parse the meminfo fixture");
+}
+
+void run_parse_disk(size_t i) {
+	(void)i;
+	unsigned long long read, written;
+	if (!parse_disk(disk_fixture, &read, &written))
+		errx(1, "failed to parse the disk fixture");
+}
+
+void run_parse_uptime(size_t i) {
+	(void)i;
+	const char* text = uptime_fixture;
+	double time;
+	if (!scan_decimal(&text, &time))
+		errx(1, "failed to parse the uptime fixture");
+}
+
+void run_parse_sensor(size_t i) {
+	(void)i;
+	unsigned long long value;
+	if (!get_sensor(&sensor_fixture, &value))
+		errx(1, "failed to parse the sensor fixture");
+}
+
+// the links are known after the first run, like in every dump but the first
+void run_parse_links(size_t i) {
+	(void)i;
+	parse_links(&parsed_links, (const char*)links_fixture, sizeof(links_fixture), 1);
+	if (parsed_links.count != LINKS_FIXTURE)
+		errx(1, "failed to parse the links fixture");
+}
+
+// the end of the dump is in a message that doesn't fit
+void run_dump_netlink_overflow(size_t i) {
+	(void)i;
+	for (size_t m = 0; m <= LINKS_FIXTURE; m++)
+		links_fixture[m].header.nlmsg_seq = dumping_links.sequence + 1;
+	for (size_t m = 0; m < DUMP_FIXTURE; m++) {
+		size_t length = (m < DUMP_FIXTURE - 1 ? LINKS_FIXTURE : LINKS_FIXTURE + 1) * sizeof(struct StatsMessage);
+		if (send(dump_pair[1], links_fixture, length, 0) == -1)
+			err(1, "failed to send the dump fixture");
+	}
+
+	struct nlmsghdr request = { .nlmsg_len = sizeof(request), .nlmsg_type = RTM_GETSTATS };
+	ssize_t length = dump_netlink(&dumping_links, &request, dump_buff, sizeof(dump_buff));
+	if (length <= 0 || (size_t)length > sizeof(dump_buff))
+		errx(1, "failed to receive the dump fixture");
+	if (recv(dump_pair[1], &request, sizeof(request), 0) == -1)
+		err(1, "failed to receive the request");
+}
+
+void run_load_pbm(const char* path) {
+	struct Bitmap bitmap = load_pbm(path);
+	free_pbm(&bitmap);
+}
+
+void run_load_pbm_template(size_t i) {
+	(void)i;
+	run_load_pbm("../bitmaps/template.pbm");
+}
+
+void run_load_pbm_template_p4(size_t i) {
+	(void)i;
+	run_load_pbm(template_p4_path);
+}
+
+void run_load_pbm_digit(size_t i) {
+	char path[] = "../bitmaps/0.pbm";
+	path[sizeof("../bitmaps/") - 1] += i % 10;
+	run_load_pbm(path);
+}
+
+// only files present on any machine are sampled, since hwmon, net and
+// block paths in stats.c are specific to the author's one
+void run_sample_stdio(size_t i) {
+	(void)i;
+	volatile double sink = sample_stdio();
+	(void)sink;
+}
+
+void run_sample_pread(size_t i) {
+	(void)i;
+	volatile double sink = sample_pread();
+	(void)sink;
+}
+
+void run_sample_uring(size_t i) {
+	(void)i;
+	volatile double sink = sample_uring();
+	(void)sink;
+}
+
+// every interface of the machine, both counters of each
+void run_sample_net_sysfs(size_t i) {
+	(void)i;
+	volatile double sink = sample_net_sysfs();
+	(void)sink;
+}
+
+void run_sample_net_rtnetlink(size_t i) {
+	(void)i;
+	volatile double sink = sample_net_rtnetlink();
+	(void)sink;
+}
+
+struct Case {
+	const char* name;
+	void (*run)(size_t i);
+};
+
+const struct Case cases[] = {
+	{ "render_plot", run_render_plot },
+	{ "render_plot_norm", run_render_plot_norm },
+	{ "render_plot_fluct", run_render_plot_fluct },
+	{ "render_plot_line", run_render_plot_line },
+	{ "render_plot_envelope", run_render_plot_envelope },
+	{ "render_scalar", run_render_scalar },
+	{ "render_scalar_prefixed", run_render_scalar_prefixed },
+	{ "render_heatmap", run_render_heatmap },
+	{ "render_screen/steady", run_render_screen_steady },
+	{ "render_screen/sampled", run_render_screen_sampled },
+	{ "pack_display/full_raw", run_pack_full_raw },
+	{ "pack_display/delta_raw", run_pack_delta_raw },
+	{ "pack_display/delta_rle", run_pack_delta_rle },
+	{ "parse_cpu", run_parse_cpu },
+	{ "parse_cores", run_parse_cores },
+	{ "parse_meminfo", run_parse_meminfo },
+	{ "parse_disk", run_parse_disk },
+	{ "parse_uptime", run_parse_uptime },
+	{ "parse_sensor", run_parse_sensor },
+	{ "parse_links", run_parse_links },
+	{ "dump_netlink/overflow", run_dump_netlink_overflow },
+	{ "load_pbm/template", run_load_pbm_template },
+	{ "load_pbm/template_p4", run_load_pbm_template_p4 },
+	{ "load_pbm/digit", run_load_pbm_digit },
+	{ "sample/stdio", run_sample_stdio },
+	{ "sample/pread", run_sample_pread },
+	{ "sample/io_uring", run_sample_uring },
+	{ "sample_net/sysfs", run_sample_net_sysfs },
+	{ "sample_net/rtnetlink", run_sample_net_rtnetlink },
+};
+
+int compare_doubles(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+struct Result {
+	double median;
+	double p99;
+	double allocs;
+};
+
+// the size of a repetition doubles until it takes long enough,
+// which also warms up caches, branch predictors and the clock
+struct Result bench_case(const struct Case* c) {
+	size_t ops = 1, done = 0;
+	for (;;) {
+		double start = get_time();
+		for (size_t i = 0; i < ops; i++)
+			c->run(done + i);
+		done += ops;
+		if (get_time() - start >= REPETITION_TIME)
+			break;
+		ops *= 2;
+	}
+
+	double times[REPETITIONS];
+	size_t allocated = allocations;
+	for (size_t r = 0; r < REPETITIONS; r++) {
+		double start = get_time();
+		for (size_t i = 0; i < ops; i++)
+			c->run(done + i);
+		times[r] = (get_time() - start) / ops * 1e9;
+		done += ops;
+	}
+	allocated = allocations - allocated;
+
+	qsort(times, REPETITIONS, sizeof(*times), compare_doubles);
+	return (struct Result) {
+		.median = times[REPETITIONS / 2],
+		.p99 = times[(REPETITIONS - 1) * 99 / 100],
+		.allocs = (double)allocated / (ops * REPETITIONS),
+	};
+}
+
+void usage(const char* name) {
+	errx(1, "usage: %s [-f filter] [-o tsv_path]", name ? name : "bench_monitor");
+}
+
+int main(int argc, char** argv) {
+	// only cases with it in the name are run
+	const char* filter = "";
+	// results are also written as tab separated values to compare between commits
+	const char* tsv_path = NULL;
+
+	for (int opt; (opt = getopt(argc, argv, "f:o:")) != -1;) {
+		if (opt == 'f')
+			filter = optarg;
+		else if (opt == 'o')
+			tsv_path = optarg;
+		else
+			usage(argv[0]);
+	}
+	if (optind != argc)
+		usage(argv[0]);
+
+	FILE* tsv = NULL;
+	if (tsv_path) {
+		tsv = fopen(tsv_path, "w");
+		if (!tsv)
+			err(1, "failed to open `%s`", tsv_path);
+		fprintf(tsv, "case\tmedian_ns\tp99_ns\tallocs_per_op\n");
+	}
+
+	init_fixtures();
+	bench_codec(frames, FRAMES);
+	printf("\n");
+
+	for (size_t c = 0; c < sizeof(cases) / sizeof(*cases); c++) {
+		if (!strstr(cases[c].name, filter))
+			continue;
+
+		struct Result result = bench_case(cases + c);
+		printf(
+			"%-24s %10.1f ns/op median %10.1f p99 %7.2f allocs/op\n",
+			cases[c].name, result.median, result.p99, result.allocs
+		);
+		if (tsv)
+			fprintf(
+				tsv, "%s\t%.1f\t%.1f\t%.2f\n",
+				cases[c].name, result.median, result.p99, result.allocs
+			);
+	}
+
+	if (tsv && (ferror(tsv) | fclose(tsv)))
+		err(1, "failed to write to `%s`", tsv_path);
+	if (unlink(template_p4_path))
+		err(1, "failed to remove `%s`", template_p4_path);
+}
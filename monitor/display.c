@@ -1,22 +1,101 @@
 #include <err.h>
+#include <errno.h>
 #include <assert.h>
 #include <ctype.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
 
 #include "display.h"
 #include "timing.h"
 
 int tcflush(int fd, int queue_selector);
 
-int init_display(const char* path, speed_t baud) {
-	int display = open(path, O_RDWR);
-	if (display == -1)
+void write_display(int display, const unsigned char* buff, size_t len) {
+	for (size_t written = 0;;) {
+		ssize_t w = write(display, buff + written, len - written);
+		if (w == -1)
+			err(1, "failed to write to the display");
+		else 
+			written += w;
+
+		if (written == len)
+			break;
+	}
+}
+
+// the first line from the board answers CMD_HELLO, the rest
+// answer CMD_FRAME, see there
+void parse_line_display(struct Display* display, char* line) {
+	for (char* c = line; *c; c++)
+		if (!isprint(*c))
+			*c = '?';
+
+	if (display->greeted) {
+		if (sscanf(line, "rx_max %zu", &display->rx_max) != 1)
+			errx(1, "display failed with the mesage `%s`", line);
+		warnx(
+			"display receive buffer peaked at %zu of %zu bytes",
+			display->rx_max, display->rx_size
+		);
+		return;
+	}
+
+	int parsed;
+	if (sscanf(line, "hello %zu%n", &display->rx_size, &parsed) != 1)
+		errx(1, "display `%s` answered hello with `%s`", display->path, line);
+
+	display->codec = CODEC_RAW;
+	for (char* codec = strtok(line + parsed, " "); codec; codec = strtok(NULL, " "))
+		if (!strcmp(codec, "rle"))
+			display->codec = CODEC_RLE;
+	display->greeted = true;
+}
+
+// with VMIN and VTIME 0 reads return 0 once the input is drained,
+// or fail with EAGAIN after the bus is started
+void read_display(struct Display* display) {
+	for (;;) {
+		size_t free = sizeof(display->line) - 1 - display->line_len;
+		ssize_t r = read(display->fd, display->line + display->line_len, free);
+		if (r == -1 && errno == EAGAIN)
+			break;
+		if (r == -1)
+			err(1, "failed to read from `%s`", display->path);
+		if (r == 0)
+			break;
+		display->line_len += r;
+
+		char* start = display->line;
+		for (char* end; (end = memchr(start, '\n', display->line + display->line_len - start));) {
+			*end = '\0';
+			parse_line_display(display, start);
+			start = end + 1;
+		}
+		display->line_len -= start - display->line;
+		memmove(display->line, start, display->line_len);
+
+		if (display->line_len == sizeof(display->line) - 1) {
+			display->line[display->line_len] = '\0';
+			for (char* c = display->line; *c; c++)
+				if (!isprint(*c))
+					*c = '?';
+			errx(1, "display failed with invalid mesage `%s`", display->line);
+		}
+	}
+}
+
+void init_display(struct Display* display, const char* path, speed_t baud) {
+	int fd = open(path, O_RDWR);
+	if (fd == -1)
 		err(1, "failed to open `%s`", path);
 
 	struct termios2 config;
-	if (ioctl(display, TCGETS2, &config))
+	if (ioctl(fd, TCGETS2, &config))
 		err(1, "failed to get terminos2 on `%s`", path);
 
 
@@ -50,86 +129,205 @@ int init_display(const char* path, speed_t baud) {
 	config.c_cflag |= BOTHER;
 
 	
-	if (ioctl(display, TCSETS2, &config))
+	if (ioctl(fd, TCSETS2, &config))
 		err(1, "failed to set terminos2 on `%s`", path);
 
 	// arduino bootloader waits for 1.6 seconds before executing code
-	sleep_until(get_time() + 2);
-
-	// TCSETSF2 doesn't work
-	if (tcflush(display, TCIOFLUSH))
-		err(1, "failed to tcflush `%s`", path);
+	display->booted = get_time() + 2;
 
-	return display;
+	display->fd = fd;
+	display->path = path;
+	display->baud = baud;
+	display->synced = false;
+	display->greeted = false;
+	display->line_len = 0;
+	display->rx_max = 0;
+	display->packet_len = display->packet_sent = 0;
 }
 
-void check_display(int display) {
-	char error[128];
-	size_t error_len = 0;
-	for (int i = 0; i < 10; i++) {
-		ssize_t r = read(display, error + error_len, sizeof(error) - error_len);
-		if (r == -1)
-			err(1, "failed to read from the display");
+// each window makes the board stall the uart for a few bytes
+#define WINDOW_BACKLOG 8
 
-		if (r == 0 && error_len == 0)
-			return;
-		error_len += r;
+// appends a window covering the changed columns of every page, only the damaged
+// columns are compared, since the rest is known to be the same as shown,
+// windows are kept within the board's receive buffer, rle ones since they are
+// received faster than passed to the display, raw ones when the baud rate is
+// faster than twi, the buffer is assumed to be drained between frames,
+// pages that don't fit are deferred to the next frame
+size_t pack_display(
+		struct Display* display,
+		unsigned char* packet,
+		const unsigned char* frame,
+		const struct Damage* damage
+) {
+	// the part of a raw byte that is still in the buffer once it's received
+	double raw_backlog = display->baud > TWI_RATE * 10 ? 1 - TWI_RATE * 10.0 / display->baud : 0;
 
-		if (i < 9)
-			sleep_until(get_time() + 0.1);
-	}
+	size_t len = 0;
+	double budget = display->rx_size;
+	for (size_t page = 0; page < DISPLAY_PAGES; page++) {
+		const unsigned char* old_row = display->shown + page * DISPLAY_WIDTH;
+		const unsigned char* new_row = frame + page * DISPLAY_WIDTH;
 
-	ssize_t start_crlf = -1, stop_crlf = -1;
-	for (size_t i = 0; i < error_len; i++)
-		if (error[i] == '\n') {
-			start_crlf = stop_crlf + 1;
-			stop_crlf = i;
+		size_t first = 0, last = DISPLAY_WIDTH - 1;
+		if (display->synced && !display->deferred[page]) {
+			if (damage) {
+				if (damage[page].first > damage[page].last)
+					continue;
+				first = damage[page].first;
+				last = damage[page].last;
+			}
+			while (first <= last && old_row[first] == new_row[first])
+				first++;
+			if (first > last)
+				continue;
+			while (old_row[last] == new_row[last])
+				last--;
 		}
+		size_t data_len = last - first + 1;
+
+		unsigned char* window = packet + len;
+		window[1] = first;
+		window[2] = last;
+		window[3] = page;
+		window[4] = page;
+
+		size_t rle_len = SIZE_MAX;
+		if (display->codec == CODEC_RLE || raw_backlog > 0)
+			budget = budget > WINDOW_BACKLOG ? budget - WINDOW_BACKLOG : 0;
+		if (display->codec == CODEC_RLE)
+			rle_len = encode_rle(packet + len + 5, new_row + first, data_len);
+
+		if (rle_len < data_len && rle_len <= budget) {
+			window[0] = CMD_WINDOW_RLE;
+			len += 5 + rle_len;
+			budget -= rle_len;
+		} else if (data_len * raw_backlog <= budget) {
+			window[0] = CMD_WINDOW;
+			memcpy(packet + len + 5, new_row + first, data_len);
+			len += 5 + data_len;
+			budget -= data_len * raw_backlog;
+		} else {
+			display->deferred[page] = true;
+			continue;
+		}
+
+		memcpy(display->shown + page * DISPLAY_WIDTH, new_row, DISPLAY_WIDTH);
+		display->deferred[page] = false;
+	}
+	packet[len++] = CMD_FRAME;
 
-	if (start_crlf == -1) {
-		for (size_t i = 0; i < error_len; i++)
-			if (!isprint(error[i]))
-				error[i] = '?';
+	display->synced = true;
+	return len;
+}
+
+void draw_display(struct Display* display, const struct Area* area, const struct Damage* damage) {
+	// the framebuffer is already in the ssd1306 page-major layout
+	assert(area->width == DISPLAY_WIDTH);
+	assert(area->height == DISPLAY_PAGES * 8);
+	assert(area->stride == DISPLAY_WIDTH);
+	assert(area->x_offset == 0 && area->y_offset == 0);
+	// the previous frame was written by flush_bus()
+	assert(display->packet_sent == display->packet_len);
 
-		if (error_len < sizeof(error))
-			errx(
-				1, "display failed and timed out with mesage `%.*s`", 
-				(int)error_len, error
-			);
+	display->packet_len = pack_display(display, display->packet, area->buff, damage);
+	display->packet_sent = 0;
+}
 
-		errx(
-			1, "display failed with invalid mesage `%.*s`",
-			(int)error_len, error
+// writes as much of the packet as the port takes, true once all of it is written
+bool send_display(struct Display* display) {
+	while (display->packet_sent < display->packet_len) {
+		ssize_t w = write(
+			display->fd,
+			display->packet + display->packet_sent,
+			display->packet_len - display->packet_sent
 		);
+		if (w == -1 && errno == EAGAIN)
+			return false;
+		if (w == -1)
+			err(1, "failed to write to `%s`", display->path);
+		display->packet_sent += w;
 	}
+	return true;
+}
 
-	errx(
-		1, "display failed with the mesage `%.*s`", 
-		(int)(stop_crlf - start_crlf), error + start_crlf
-	);
+void init_bus(struct Bus* bus) {
+	bus->count = 0;
+	bus->epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (bus->epoll == -1)
+		err(1, "failed to create epoll for the displays");
 }
 
-void draw_display(int display, const struct Area* area) {
-	assert(area->width == 128);
-	assert(area->height == 64);
+void add_bus(struct Bus* bus, struct Display* display) {
+	if (bus->count == BUS_DISPLAYS)
+		errx(1, "more than %d displays", BUS_DISPLAYS);
+	bus->displays[bus->count++] = display;
+
+	// edge triggered, so ports are only watched for writability
+	// when a write didn't go through
+	struct epoll_event event = { .events = EPOLLIN | EPOLLOUT | EPOLLET, .data.ptr = display };
+	if (epoll_ctl(bus->epoll, EPOLL_CTL_ADD, display->fd, &event))
+		err(1, "failed to add `%s` to epoll", display->path);
+}
 
-	unsigned char buff[1024] = {};
-	for (size_t i = 0; i < sizeof(buff); i++) {
-		for (int j = 0; j < 8; j++)
-			//buff[i] |= area->buff[i / 128 * 8 + j][i % 128] << j;
-			buff[i] |= get_area(area, i % 128, i / 128 * 8 + j) << j;
+// handles the ports that became ready within timeout ms,
+// returns how many displays finished writing their frames
+size_t poll_bus(struct Bus* bus, int timeout) {
+	struct epoll_event events[BUS_DISPLAYS];
+	int ready = epoll_wait(bus->epoll, events, BUS_DISPLAYS, timeout);
+	if (ready == -1 && errno != EINTR)
+		err(1, "failed to wait for the displays");
+
+	size_t sent = 0;
+	for (int i = 0; i < ready; i++) {
+		struct Display* display = events[i].data.ptr;
+		if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+			read_display(display);
+		if (events[i].events & EPOLLOUT && display->packet_sent < display->packet_len)
+			sent += send_display(display);
 	}
+	return sent;
+}
 
-	for (ssize_t written = 0;;) {
-		ssize_t w = write(display, buff + written, sizeof(buff) - written);
-		if (w == -1)
-			err(1, "failed to write to the display");
-		else 
-			written += w;
+void start_bus(struct Bus* bus) {
+	for (size_t i = 0; i < bus->count; i++) {
+		struct Display* display = bus->displays[i];
+		// the boards boot at the same time
+		sleep_until(display->booted);
+		// TCSETSF2 doesn't work
+		if (tcflush(display->fd, TCIOFLUSH))
+			err(1, "failed to tcflush `%s`", display->path);
+		// asks the board which codecs it supports, see CMD_HELLO
+		write_display(display->fd, (const unsigned char[]) { CMD_HELLO }, 1);
+	}
 
-		if (written == sizeof(buff))
-			break;
+	double deadline = get_time() + 1;
+	for (size_t i = 0; i < bus->count; i++) {
+		struct Display* display = bus->displays[i];
+		while (!display->greeted) {
+			double left = deadline - get_time();
+			if (left <= 0)
+				errx(1, "display `%s` didn't answer hello", display->path);
+			poll_bus(bus, left * 1000 + 1);
+		}
+	}
+
+	// from now on a slow port doesn't hold up the others
+	for (size_t i = 0; i < bus->count; i++) {
+		int fd = bus->displays[i]->fd;
+		int flags = fcntl(fd, F_GETFL);
+		if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK))
+			err(1, "failed to make `%s` nonblocking", bus->displays[i]->path);
 	}
+}
+
+void flush_bus(struct Bus* bus) {
+	size_t pending = 0;
+	for (size_t i = 0; i < bus->count; i++)
+		pending += !send_display(bus->displays[i]);
+	while (pending)
+		pending -= poll_bus(bus, -1);
 
-	check_display(display);
+	// the boards rarely talk, the frame doesn't wait for them
+	poll_bus(bus, 0);
 }
@@ -1,14 +1,90 @@
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
+#include <stdbool.h>
 #include <asm/termbits.h>
 
 #include "area.h"
+#include "protocol.h"
+#include "rle.h"
 
-int init_display(const char* path, speed_t baud);
+enum Codec {
+	CODEC_RAW,
+	CODEC_RLE,
+};
+
+// every page in its own window and the end of the frame
+#define PACKET_SIZE (DISPLAY_PAGES * (5 + RLE_BOUND(DISPLAY_WIDTH)) + 1)
+
+struct Display {
+	int fd;
+	const char* path;
+	// when the board is done booting, see start_bus()
+	double booted;
+	// status lines are read only once they arrive
+	char line[128];
+	size_t line_len;
+	bool greeted;
+	// negotiated with the board on init
+	enum Codec codec;
+	size_t rx_size;
+	// worst receive buffer occupancy the board reported
+	size_t rx_max;
+	// bits per second, windows are kept within the receive buffer
+	// when it's faster than the board passes them on, see TWI_RATE
+	speed_t baud;
+	// what the display is showing, only the difference is sent
+	unsigned char shown[1024];
+	bool synced;
+	// pages that didn't fit into the receive buffer, they are sent
+	// whole in the next frame, regardless of its damage
+	bool deferred[DISPLAY_PAGES];
+	// the frame draw_display() packed, written by flush_bus()
+	unsigned char packet[PACKET_SIZE];
+	size_t packet_len;
+	size_t packet_sent;
+};
+
+// the board is greeted once it's added to a bus and the bus is started
+void init_display(struct Display* display, const char* path, speed_t baud);
 
 // since the program will never stop and free it's resources, there is no free_display()
 
-void draw_display(int display, const struct Area* area);
+// packs commands updating the display to the frame into packet of PACKET_SIZE
+// and returns their length, the display is assumed to show the frame afterwards,
+// except for the pages deferred to the next frame, damage of DISPLAY_PAGES pages
+// limits the columns that could have changed, with NULL damage any of them could
+size_t pack_display(
+		struct Display* display,
+		unsigned char* packet,
+		const unsigned char* frame,
+		const struct Damage* damage
+);
+
+// packs the frame, it's written by flush_bus()
+void draw_display(struct Display* display, const struct Area* area, const struct Damage* damage);
+
+#define BUS_DISPLAYS 16
+
+// the displays are written at the same time, each one as fast as its port
+// takes it, all of the ports are multiplexed through one epoll
+struct Bus {
+	int epoll;
+	struct Display* displays[BUS_DISPLAYS];
+	size_t count;
+};
+
+void init_bus(struct Bus* bus);
+
+// since the program will never stop and free it's resources, there is no free_bus()
+
+void add_bus(struct Bus* bus, struct Display* display);
+
+// waits for the boards to boot and asks each one which codecs it supports
+void start_bus(struct Bus* bus);
+
+// writes the frames packed by draw_display() and reads the lines
+// the boards sent meanwhile, returns once every frame is written
+void flush_bus(struct Bus* bus);
 
 #endif
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#include "history.h"
+
+void alloc_tier(struct Tier* tier, size_t capacity, size_t span, struct Arena* arena) {
+	assert(span);
+	tier->span = span;
+	tier->count = 0;
+	alloc_tracked_ring_in(&tier->mins, capacity, arena);
+	alloc_tracked_ring_in(&tier->maxs, capacity, arena);
+	alloc_tracked_ring_in(&tier->means, capacity, arena);
+}
+
+void alloc_history_in(
+		struct History* history,
+		size_t capacity,
+		size_t samples_per_minute,
+		struct Arena* arena
+) {
+	alloc_tracked_ring_in(&history->samples, capacity, arena);
+	alloc_tier(&history->minutes, capacity, samples_per_minute, arena);
+	alloc_tier(&history->hours, capacity, 60, arena);
+}
+
+bool rebind_tier(struct Tier* tier, size_t capacity, size_t span, struct Arena* arena) {
+	return rebind_tracked_ring_in(&tier->mins, capacity, arena) &&
+		rebind_tracked_ring_in(&tier->maxs, capacity, arena) &&
+		rebind_tracked_ring_in(&tier->means, capacity, arena) &&
+		tier->span == span && tier->count < span;
+}
+
+bool rebind_history_in(
+		struct History* history,
+		size_t capacity,
+		size_t samples_per_minute,
+		struct Arena* arena
+) {
+	return rebind_tracked_ring_in(&history->samples, capacity, arena) &&
+		rebind_tier(&history->minutes, capacity, samples_per_minute, arena) &&
+		rebind_tier(&history->hours, capacity, 60, arena);
+}
+
+void alloc_history(struct History* history, size_t capacity, size_t samples_per_minute) {
+	alloc_history_in(history, capacity, samples_per_minute, NULL);
+}
+
+// returns true when the bucket is complete and pushed to the rings
+bool push_tier(struct Tier* tier, double min, double max, double mean) {
+	if (!tier->count) {
+		tier->min = min;
+		tier->max = max;
+		tier->sum = 0;
+	}
+	if (min < tier->min)
+		tier->min = min;
+	if (max > tier->max)
+		tier->max = max;
+	tier->sum += mean;
+
+	if (++tier->count < tier->span)
+		return false;
+
+	push_ring(&tier->mins, tier->min);
+	push_ring(&tier->maxs, tier->max);
+	push_ring(&tier->means, tier->sum / tier->span);
+	tier->count = 0;
+	return true;
+}
+
+// hours are consolidated from minutes, which all have the same weight
+void push_history(struct History* history, double value) {
+	push_ring(&history->samples, value);
+
+	struct Tier* minutes = &history->minutes;
+	if (push_tier(minutes, value, value, value)) {
+		size_t last = minutes->means.length - 1;
+		push_tier(
+			&history->hours,
+			get_ring(&minutes->mins, last),
+			get_ring(&minutes->maxs, last),
+			get_ring(&minutes->means, last)
+		);
+	}
+}
+
+const struct Ring* get_tier(const struct Tier* tier, enum Consolidation consolidation) {
+	switch (consolidation) {
+	case CONSOLIDATION_MIN:
+		return &tier->mins;
+	case CONSOLIDATION_MAX:
+		return &tier->maxs;
+	case CONSOLIDATION_MEAN:
+		return &tier->means;
+	}
+	assert(false);
+	return NULL;
+}
+
+const struct Ring* get_history(
+		const struct History* history,
+		enum Resolution resolution,
+		enum Consolidation consolidation
+) {
+	switch (resolution) {
+	case RESOLUTION_SAMPLE:
+		return &history->samples;
+	case RESOLUTION_MINUTE:
+		return get_tier(&history->minutes, consolidation);
+	case RESOLUTION_HOUR:
+		return get_tier(&history->hours, consolidation);
+	}
+	assert(false);
+	return NULL;
+}
@@ -0,0 +1,75 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ring.h"
+
+enum Resolution {
+	RESOLUTION_SAMPLE,
+	RESOLUTION_MINUTE,
+	RESOLUTION_HOUR,
+};
+
+enum Consolidation {
+	CONSOLIDATION_MIN,
+	CONSOLIDATION_MAX,
+	CONSOLIDATION_MEAN,
+};
+
+// every span values of the finer tier are consolidated into a bucket
+struct Tier {
+	size_t span;
+	size_t count;
+	double min;
+	double max;
+	double sum;
+	struct Ring mins;
+	struct Ring maxs;
+	struct Ring means;
+};
+
+// the samples and their consolidations, each ring holds capacity values,
+// so the memory and the cost of a push don't depend on the time span
+struct History {
+	struct Ring samples;
+	struct Tier minutes;
+	struct Tier hours;
+};
+
+void alloc_history(struct History* history, size_t capacity, size_t samples_per_minute);
+
+// same as alloc_history, but the memory is taken from the arena
+void alloc_history_in(
+		struct History* history,
+		size_t capacity,
+		size_t samples_per_minute,
+		struct Arena* arena
+);
+
+// points a history, whose rings are already in the arena, to them,
+// in the same order alloc_history_in takes them, false if any of them
+// doesn't match the capacity and spans, e.g. the history is corrupt
+bool rebind_history_in(
+		struct History* history,
+		size_t capacity,
+		size_t samples_per_minute,
+		struct Arena* arena
+);
+
+// arena space taken by a history
+#define HISTORY_SIZE(capacity) (7 * TRACKED_RING_SIZE(capacity))
+
+// since the program will never stop and free it's resources, there is no free_history()
+
+void push_history(struct History* history, double value);
+
+// consolidation is ignored for samples
+const struct Ring* get_history(
+		const struct History* history,
+		enum Resolution resolution,
+		enum Consolidation consolidation
+);
+
+#endif
@@ -0,0 +1,145 @@
+#include <err.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hwmon.h"
+#include "scan.h"
+
+#define HWMON_PATH "/sys/class/hwmon"
+
+// names of the devices and of the files of a device, see list_source(),
+// some boards expose hundreds of inputs
+static char devices_buff[4096];
+static char files_buff[64 * 1024];
+// the devices the sensors were last found among
+static char found_buff[sizeof(devices_buff)];
+
+// the first line of a small file, read once
+void read_line(const char* path, char* line, size_t size) {
+	struct Source source = { .path = path, .fd = -1, .buff = line, .size = size };
+	read_source(&source);
+	if (source.fd != -1)
+		close(source.fd);
+	line[strcspn(line, "\n")] = '\0';
+}
+
+// the input named by the label file of the device, false if there is none
+bool find_label(const char* dir, const char* files, const char* label, char* input, size_t size) {
+	const size_t suffix = sizeof("_label") - 1;
+	for (const char* name = files; *name;) {
+		const char* entry = name;
+		size_t length = strcspn(name, "\n");
+		name += length + (name[length] == '\n');
+		if (length <= suffix || strncmp(entry + length - suffix, "_label", suffix))
+			continue;
+
+		char path[PATH_MAX], line[64];
+		snprintf(path, sizeof(path), "%s/%.*s", dir, (int)length, entry);
+		read_line(path, line, sizeof(line));
+		if (!strcmp(line, label)) {
+			snprintf(input, size, "%.*s_input", (int)(length - suffix), entry);
+			return true;
+		}
+	}
+	return false;
+}
+
+// without hwmon there are no devices
+void list_devices() {
+	struct Source devices = SOURCE(HWMON_PATH, devices_buff);
+	devices.fallible = true;
+	list_source(&devices);
+}
+
+void find_sensors(struct Sensor* sensors, size_t count) {
+	memcpy(found_buff, devices_buff, sizeof(found_buff));
+
+	for (const char* device = devices_buff; *device;) {
+		size_t length = strcspn(device, "\n");
+		// the directory leaves room for the names of its files
+		char dir[PATH_MAX / 2], path[PATH_MAX], name[64];
+		snprintf(dir, sizeof(dir), HWMON_PATH "/%.*s", (int)length, device);
+		device += length + (device[length] == '\n');
+
+		snprintf(path, sizeof(path), "%s/name", dir);
+		if (!exists_source(path))
+			continue;
+		read_line(path, name, sizeof(name));
+
+		// the files are listed only once and only if a sensor needs them
+		bool listed = false;
+		for (size_t i = 0; i < count; i++) {
+			struct Sensor* sensor = sensors + i;
+			if (sensor->source.path || strncmp(name, sensor->device, strlen(sensor->device)))
+				continue;
+
+			char input[64];
+			if (sensor->label) {
+				if (!listed) {
+					struct Source files = SOURCE(dir, files_buff);
+					list_source(&files);
+					listed = true;
+				}
+				if (!find_label(dir, files_buff, sensor->label, input, sizeof(input)))
+					continue;
+			} else {
+				snprintf(input, sizeof(input), "%s", sensor->input);
+			}
+
+			snprintf(path, sizeof(path), "%s/%s", dir, input);
+			if (!exists_source(path))
+				continue;
+
+			sensor->source = (struct Source) {
+				.path = strdup(path),
+				.fd = -1,
+				.buff = sensor->buff,
+				.size = sizeof(sensor->buff),
+				.fallible = true,
+			};
+			if (!sensor->source.path)
+				err(1, "failed to allocate memory for sensors");
+			open_source(&sensor->source);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+		if (!sensors[i].source.path)
+			warnx(
+				"sensor `%s` of `%s` wasn't found",
+				sensors[i].label ? sensors[i].label : sensors[i].input, sensors[i].device
+			);
+}
+
+void init_sensors(struct Sensor* sensors, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		sensors[i].source.path = NULL;
+	list_devices();
+	find_sensors(sensors, count);
+}
+
+bool rescan_sensors(struct Sensor* sensors, size_t count) {
+	list_devices();
+	if (!strcmp(devices_buff, found_buff))
+		return false;
+
+	for (size_t i = 0; i < count; i++) {
+		struct Source* source = &sensors[i].source;
+		if (!source->path)
+			continue;
+		if (source->fd != -1)
+			close(source->fd);
+		free((char*)source->path);
+		source->path = NULL;
+	}
+	find_sensors(sensors, count);
+	return true;
+}
+
+bool get_sensor(const struct Sensor* sensor, unsigned long long* value) {
+	const char* text = sensor->buff;
+	return sensor->source.path && !sensor->source.failed && scan_u64(&text, value);
+}
@@ -0,0 +1,35 @@
+#ifndef HWMON_H
+#define HWMON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "source.h"
+
+// an input of a hwmon device found by the name of the device,
+// since the hwmonN numbers change between boots
+struct Sensor {
+	// the name of the device or its beginning, e.g. "nct67" for any nct6775 chip
+	const char* device;
+	// the input with this label, or the input file itself if it's NULL
+	const char* label;
+	const char* input;
+
+	// the path is NULL if the sensor wasn't found
+	struct Source source;
+	char buff[32];
+};
+
+// finds and opens the sensors, it reads the names of all the devices,
+// but only lists the files of the ones that match a sensor,
+// without /sys/class/hwmon none are found
+void init_sensors(struct Sensor* sensors, size_t count);
+
+// lists the devices and if they changed since the sensors were found, closes
+// the sensors and finds them again, returns whether it did
+bool rescan_sensors(struct Sensor* sensors, size_t count);
+
+// the first number in the sensor's file, false if the sensor is missing or failed
+bool get_sensor(const struct Sensor* sensor, unsigned long long* value);
+
+#endif
@@ -0,0 +1,294 @@
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+#include "links.h"
+
+// a RTM_NEWSTATS message is 232 bytes, a RTM_NEWLINK one is a few kilobytes
+static char stats_buff[32 * 1024];
+static char infos_buff[256 * 1024];
+static char events_buff[2];
+
+// a message of a dump that doesn't fit, whole, so its end is seen,
+// the kernel doesn't make a dump's messages bigger than 32 KiB
+static char drop_buff[32 * 1024];
+
+// whether the messages end the dump, -errno if the kernel failed it
+int end_netlink(const char* chunk, size_t length) {
+	for (const struct nlmsghdr* header = (const void*)chunk; NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+		if (header->nlmsg_type == NLMSG_DONE)
+			return 1;
+		if (header->nlmsg_type == NLMSG_ERROR)
+			return ((const struct nlmsgerr*)NLMSG_DATA(header))->error;
+	}
+	return 0;
+}
+
+// the length of the whole messages at the start of the chunk that fit in free
+size_t fit_netlink(const char* chunk, size_t length, size_t free) {
+	size_t fit = 0;
+	for (const struct nlmsghdr* header = (const void*)chunk; NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+		if (fit + NLMSG_ALIGN(header->nlmsg_len) > free)
+			break;
+		fit += NLMSG_ALIGN(header->nlmsg_len);
+	}
+	return fit;
+}
+
+// opens a NETLINK_ROUTE socket in the groups, returns its port
+uint32_t open_netlink(int* fd, uint32_t groups) {
+	*fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | (groups ? SOCK_NONBLOCK : 0), NETLINK_ROUTE);
+	if (*fd == -1)
+		err(1, "failed to open rtnetlink");
+
+	// the kernel picks the port
+	struct sockaddr_nl address = { .nl_family = AF_NETLINK, .nl_groups = groups };
+	socklen_t address_length = sizeof(address);
+	if (bind(*fd, (struct sockaddr*)&address, sizeof(address)) == -1)
+		err(1, "failed to bind rtnetlink");
+	if (getsockname(*fd, (struct sockaddr*)&address, &address_length) == -1)
+		err(1, "failed to get the port of rtnetlink");
+	return address.nl_pid;
+}
+
+ssize_t dump_netlink(struct Links* links, struct nlmsghdr* request, char* buff, size_t size) {
+	if (links->fd == -1)
+		links->port = open_netlink(&links->fd, 0);
+
+	request->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	request->nlmsg_seq = ++links->sequence;
+	if (send(links->fd, request, request->nlmsg_len, 0) == -1)
+		return -errno;
+
+	size_t length = 0;
+	for (;;) {
+		// peeking tells the size of the next message, one that doesn't fit
+		// is received whole elsewhere, since the end of the dump may be in it
+		ssize_t r = recv(links->fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r == -1)
+			return -errno;
+		if ((size_t)r > sizeof(drop_buff))
+			return -EMSGSIZE;
+
+		bool fits = (size_t)r <= size - length;
+		char* chunk = fits ? buff + length : drop_buff;
+		r = recv(links->fd, chunk, fits ? size - length : sizeof(drop_buff), 0);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r == -1)
+			return -errno;
+
+		// the rest of a dump that failed earlier, the kernel doesn't mix dumps in a message
+		const struct nlmsghdr* header = (const void*)chunk;
+		if ((size_t)r >= sizeof(*header) && (header->nlmsg_seq != links->sequence || header->nlmsg_pid != links->port))
+			continue;
+
+		int end = end_netlink(chunk, r);
+		if (end < 0)
+			return end;
+
+		// the messages that don't fit are dropped
+		if (fits) {
+			length += r;
+		} else {
+			size_t fit = fit_netlink(chunk, r, size - length);
+			memcpy(buff + length, chunk, fit);
+			length += fit;
+		}
+		if (end)
+			return length;
+	}
+}
+
+ssize_t fetch_stats(char* buff, size_t size, void* arg) {
+	struct {
+		struct nlmsghdr header;
+		struct if_stats_msg message;
+	} request = {
+		.header = { .nlmsg_len = sizeof(request), .nlmsg_type = RTM_GETSTATS },
+		.message = { .filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64) },
+	};
+	return dump_netlink(arg, &request.header, buff, size);
+}
+
+ssize_t fetch_infos(char* buff, size_t size, void* arg) {
+	struct {
+		struct nlmsghdr header;
+		struct ifinfomsg message;
+	} request = {
+		.header = { .nlmsg_len = sizeof(request), .nlmsg_type = RTM_GETLINK },
+	};
+	return dump_netlink(arg, &request.header, buff, size);
+}
+
+// drains the announcements of changed links, returns 1 if there were any
+ssize_t fetch_events(char* buff, size_t size, void* arg) {
+	struct Links* links = arg;
+	if (links->events_fd == -1)
+		open_netlink(&links->events_fd, RTMGRP_LINK);
+
+	ssize_t announced = 0;
+	for (;;) {
+		ssize_t r = recv(links->events_fd, drop_buff, sizeof(drop_buff), MSG_TRUNC);
+		if (r == -1 && errno == EINTR)
+			continue;
+		// the announcements that overflowed the socket are lost, which is a change too
+		if (r == -1 && errno == ENOBUFS) {
+			announced = 1;
+			continue;
+		}
+		if (r == -1 && errno == EAGAIN)
+			break;
+		if (r == -1)
+			return -errno;
+		announced = 1;
+	}
+
+	if (announced && size)
+		buff[0] = '1';
+	return announced && size;
+}
+
+void init_links(struct Links* links) {
+	links->fd = links->events_fd = -1;
+	links->port = 0;
+	links->sequence = 0;
+	links->stats = (struct Source)SOURCE("rtnetlink:stats", stats_buff);
+	links->infos = (struct Source)SOURCE("rtnetlink:links", infos_buff);
+	links->events = (struct Source)SOURCE("rtnetlink:events", events_buff);
+	// a failed dump is retried on the next sample
+	links->stats.fallible = links->infos.fallible = links->events.fallible = true;
+	links->stale = false;
+	links->count = 0;
+	links->time = 0;
+	links->rx = links->tx = 0;
+}
+
+int compare_links(const void* a, const void* b) {
+	const struct Link* link_a = a;
+	const struct Link* link_b = b;
+	return (link_a->index > link_b->index) - (link_a->index < link_b->index);
+}
+
+struct Link* find_link(struct Link* links, size_t count, int index) {
+	struct Link key = { .index = index };
+	return bsearch(&key, links, count, sizeof(struct Link), compare_links);
+}
+
+// the counter either went up since the previous dump or was reset to 0
+double rate_link(unsigned long long previous, unsigned long long value, double elapsed) {
+	return (value >= previous ? value - previous : value) / elapsed;
+}
+
+// names the links and decides which are counted, if the dump fails,
+// the links keep what they were and the new ones aren't counted until the next one
+void describe_links(struct Links* links) {
+	fetch_source(&links->infos, fetch_infos, links);
+	links->stale = links->infos.failed;
+
+	size_t length = links->infos.length;
+	for (const struct nlmsghdr* header = (const void*)infos_buff; NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+		if (header->nlmsg_type != RTM_NEWLINK)
+			continue;
+		const struct ifinfomsg* info = NLMSG_DATA(header);
+		struct Link* link = find_link(links->links, links->count, info->ifi_index);
+		if (!link)
+			continue;
+
+		bool enslaved = false, stacked = false;
+		size_t attrs_length = IFLA_PAYLOAD(header);
+		for (const struct rtattr* attr = IFLA_RTA(info); RTA_OK(attr, attrs_length); attr = RTA_NEXT(attr, attrs_length)) {
+			if (attr->rta_type == IFLA_IFNAME) {
+				size_t name_length = RTA_PAYLOAD(attr) < sizeof(link->name) ? RTA_PAYLOAD(attr) : sizeof(link->name);
+				memcpy(link->name, RTA_DATA(attr), name_length);
+				link->name[sizeof(link->name) - 1] = '\0';
+			} else if (attr->rta_type == IFLA_MASTER) {
+				enslaved = true;
+			} else if (attr->rta_type == IFLA_LINK && RTA_PAYLOAD(attr) >= sizeof(int)) {
+				int lower;
+				memcpy(&lower, RTA_DATA(attr), sizeof(lower));
+				stacked = lower != info->ifi_index;
+			}
+		}
+		link->counted = !(info->ifi_flags & IFF_LOOPBACK) && !enslaved && !stacked;
+	}
+}
+
+bool parse_links(struct Links* links, const char* dump, size_t length, double elapsed) {
+	struct Link previous[MAX_INTERFACES];
+	size_t previous_count = links->count;
+	memcpy(previous, links->links, previous_count * sizeof(struct Link));
+
+	// the new ones are named after the dump
+	bool appeared = false;
+	links->count = 0;
+	for (const struct nlmsghdr* header = (const void*)dump; NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+		if (header->nlmsg_type != RTM_NEWSTATS)
+			continue;
+		if (links->count == MAX_INTERFACES)
+			break;
+		const struct if_stats_msg* message = NLMSG_DATA(header);
+
+		const struct rtattr* attr = (const void*)((const char*)message + NLMSG_ALIGN(sizeof(*message)));
+		size_t attrs_length = header->nlmsg_len - NLMSG_LENGTH(sizeof(*message));
+		for (; RTA_OK(attr, attrs_length); attr = RTA_NEXT(attr, attrs_length))
+			if (attr->rta_type == IFLA_STATS_LINK_64)
+				break;
+		if (!RTA_OK(attr, attrs_length))
+			continue;
+
+		// older kernels have fewer fields at the end
+		struct rtnl_link_stats64 counters = {};
+		size_t counters_length = RTA_PAYLOAD(attr);
+		memcpy(&counters, RTA_DATA(attr), counters_length < sizeof(counters) ? counters_length : sizeof(counters));
+
+		struct Link* link = links->links + links->count++;
+		const struct Link* known = find_link(previous, previous_count, message->ifindex);
+		if (known) {
+			*link = *known;
+			link->rx = rate_link(known->rx_bytes, counters.rx_bytes, elapsed);
+			link->tx = rate_link(known->tx_bytes, counters.tx_bytes, elapsed);
+		} else {
+			*link = (struct Link) { .index = message->ifindex };
+			appeared = true;
+		}
+		link->rx_bytes = counters.rx_bytes;
+		link->tx_bytes = counters.tx_bytes;
+	}
+
+	// the dump is in the order of the kernel's hash table
+	qsort(links->links, links->count, sizeof(struct Link), compare_links);
+	return appeared;
+}
+
+void update_links(struct Links* links) {
+	// a failed drain may have lost announcements as well
+	fetch_source(&links->events, fetch_events, links);
+	if (links->events.length || links->events.failed)
+		links->stale = true;
+
+	// the rates stay as they were, the next dump's are over both samples
+	fetch_source(&links->stats, fetch_stats, links);
+	if (links->stats.failed)
+		return;
+	double elapsed = links->stats.time - links->time;
+	links->time = links->stats.time;
+
+	if (parse_links(links, stats_buff, links->stats.length, elapsed) || links->stale)
+		describe_links(links);
+
+	links->rx = links->tx = 0;
+	for (size_t i = 0; i < links->count; i++)
+		if (links->links[i].counted) {
+			links->rx += links->links[i].rx;
+			links->tx += links->links[i].tx;
+		}
+}
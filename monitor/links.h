@@ -0,0 +1,74 @@
+#ifndef LINKS_H
+#define LINKS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+
+#include "source.h"
+
+// interfaces past it are ignored
+#define MAX_INTERFACES 64
+
+// a network interface, known by its ifindex, since names change
+struct Link {
+	int index;
+	char name[IF_NAMESIZE];
+	// whether it's in the totals, which are of the interfaces the traffic of the host
+	// goes through, the loopback isn't, neither are ports of bonds and bridges,
+	// which their master counts, nor vlans and such, which their lower interface counts
+	bool counted;
+	unsigned long long rx_bytes;
+	unsigned long long tx_bytes;
+	// bytes per second since the previous dump, 0 in the dump the interface appeared in,
+	// counters that went back are taken as reset to 0
+	double rx;
+	double tx;
+};
+
+// every interface of the network namespace, the counters of all of them come in
+// a single RTM_GETSTATS dump, their names and the rest in a RTM_GETLINK dump,
+// which is only done when interfaces come or go or the kernel announces a change
+// of one, e.g. it was enslaved to a bond, the dumps and the announcements are
+// recorded and replayed like sources, netlink isn't under the sysroot
+struct Links {
+	// NETLINK_ROUTE, opened on the first dump, so they aren't when replaying,
+	// the one for the dumps and the one the changes are announced to
+	int fd;
+	int events_fd;
+	// of the dump socket, replies to other requests are dropped
+	uint32_t port;
+	uint32_t sequence;
+	struct Source stats;
+	struct Source infos;
+	struct Source events;
+	// the names are out of date, since a dump failed or a change was announced
+	bool stale;
+
+	// sorted by index
+	struct Link links[MAX_INTERFACES];
+	size_t count;
+	// when the counters were dumped, a failed dump leaves the rates as they were
+	double time;
+	// of the counted links
+	double rx;
+	double tx;
+};
+
+void init_links(struct Links* links);
+
+// since the program will never stop and free it's resources, there is no free_links()
+
+void update_links(struct Links* links);
+
+// sends the request and receives the whole dump into buff, the messages
+// that don't fit are dropped, returns the length or -errno
+ssize_t dump_netlink(struct Links* links, struct nlmsghdr* request, char* buff, size_t size);
+
+// the parser of a RTM_GETSTATS dump, the rates are since the counters the links
+// had before, returns whether any link appeared, which update_links() then names
+bool parse_links(struct Links* links, const char* dump, size_t length, double elapsed);
+
+#endif
@@ -1,165 +1,348 @@
 #include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "render.h"
-#include "display.h"
+#include "screen.h"
+#include "output.h"
+#include "queue.h"
 #include "timing.h"
 #include "stats.h"
+#include "source.h"
+
+// samples buffered between renders, dropped when the renderer falls behind
+#define STATS_QUEUE 64
+// frames being written and rendered at the same time, skipped when the writer falls behind
+#define FRAME_QUEUE 2
+// given with -o, every serial one is on the bus
+#define OUTPUTS BUS_DISPLAYS
+
+void usage(const char* name) {
+	errx(
+		1,
+		"usage: %s [-r sample|minute|hour] [-c min|max|mean] [-s state_path]"
+		" [-S sample_hz] [-D display_hz] [-T text_hz] [-o output[,baud=N][,view=N]]... [-b baud] [-p]"
+		" [-R sysroot] [-W record_path | -P replay_path] [-a assets_path]",
+		name ? name : "monitor"
+	);
+}
 
-#define PLOT_WIDTH 38
-#define PLOT_HEIGHT 10
-#define UPD_PER_SEC 1.0
-
-int main() {
-	init_render("../bitmaps");
-	int display = init_display("/dev/ttyUSB0", 666666);
-	struct Bitmap template = load_exp_pbm("../bitmaps/template.pbm", 128, 64);
-
-
-	struct Area area;
-	alloc_area(&area, 128, 64);
-	render_bitmap(&area, &template);
-
-	struct Area cpu_plot_area;
-	subarea(&area, &cpu_plot_area, 0, 0, PLOT_WIDTH, PLOT_HEIGHT);
-
-	struct Area cpu_tmp_plot_area;
-	subarea(&area, &cpu_tmp_plot_area, 0, 12, PLOT_WIDTH, PLOT_HEIGHT);
-
-	struct Area ram_tmp_plot_area;
-	subarea(&area, &ram_tmp_plot_area, 0, 42, PLOT_WIDTH, PLOT_HEIGHT);
-
-	struct Area ram_plot_area;
-	subarea(&area, &ram_plot_area, 0, 54, PLOT_WIDTH, PLOT_HEIGHT);
-
-	struct Area net_tx_area;
-	subarea(&area, &net_tx_area, 90, 0, PLOT_WIDTH, PLOT_HEIGHT);
-
-	struct Area net_rx_area;
-	subarea(&area, &net_rx_area, 90, 12, PLOT_WIDTH, PLOT_HEIGHT);
-
-	struct Area disk_r_area;
-	subarea(&area, &disk_r_area, 90, 42, PLOT_WIDTH, PLOT_HEIGHT);
-
-	struct Area disk_w_area;
-	subarea(&area, &disk_w_area, 90, 54, PLOT_WIDTH, PLOT_HEIGHT);
-
-
-	struct Area cpu_scalar_area;
-	subarea(&area, &cpu_scalar_area, 49, 6, 11, 4);
-
-	struct Area cpu_tmp_scalar_area;
-	subarea(&area, &cpu_tmp_scalar_area, 49, 12, 11, 4);
-
-	struct Area ram_tmp_scalar_area;
-	subarea(&area, &ram_tmp_scalar_area, 49, 48, 11, 4);
-
-	struct Area ram_scalar_area;
-	subarea(&area, &ram_scalar_area, 49, 54, 11, 4);
-
-	struct Area net_tx_scalar_area;
-	subarea(&area, &net_tx_scalar_area, 53, 0, 33, 4);
-
-	struct Area net_rx_scalar_area;
-	subarea(&area, &net_rx_scalar_area, 53, 18, 33, 4);
-
-	struct Area disk_r_scalar_area;
-	subarea(&area, &disk_r_scalar_area, 53, 42, 33, 4);
-
-	struct Area disk_w_scalar_area;
-	subarea(&area, &disk_w_scalar_area, 53, 60, 33, 4);
-
+double parse_rate(const char* arg, const char* name) {
+	char* end;
+	double rate = strtod(arg, &end);
+	if (end == arg || *end || !(rate > 0))
+		usage(name);
+	return rate;
+}
 
-	struct Area uptime_days_area;
-	subarea(&area, &uptime_days_area, 94, 25, 11, 4);
+// the same as the baud option of outputs
+speed_t parse_baud(const char* arg, const char* name) {
+	speed_t baud;
+	if (!parse_baud_output(arg, &baud))
+		usage(name);
+	return baud;
+}
 
-	struct Area uptime_hours_area;
-	subarea(&area, &uptime_hours_area, 98, 30, 7, 4);
+// the views are rendered once, whichever outputs show them
+struct Outputs {
+	struct Output list[OUTPUTS];
+	size_t count;
+	struct Bus bus;
+};
 
-	struct Area uptime_minutes_area;
-	subarea(&area, &uptime_minutes_area, 98, 35, 7, 4);
+void begin_outputs(struct Outputs* outputs) {
+	for (size_t i = 0; i < outputs->count; i++)
+		begin_output(outputs->list + i);
+}
 
+void end_outputs(struct Outputs* outputs) {
+	for (size_t i = 0; i < outputs->count; i++)
+		end_output(outputs->list + i);
+}
 
-	struct Area fan1_area;
-	subarea(&area, &fan1_area, 18, 25, 15, 4);
+// areas and damage of VIEWS views, of the ones shown by the outputs,
+// the serial displays are written at the same time
+void draw_outputs(
+		struct Outputs* outputs,
+		const struct Area* areas,
+		struct Damage (*damage)[DISPLAY_PAGES]
+) {
+	for (size_t i = 0; i < outputs->count; i++) {
+		struct Output* output = outputs->list + i;
+		draw_output(output, areas + output->view, damage[output->view]);
+	}
+	flush_bus(&outputs->bus);
+}
 
-	struct Area fan2_area;
-	subarea(&area, &fan2_area, 18, 30, 15, 4);
+void run_sequential(struct Screen* screen, struct Outputs* outputs, struct Timer** timers) {
+	struct Timer* sample_timer = timers[0];
+	struct Timer* display_timer = timers[1];
+	struct Timer* text_timer = timers[2];
 
-	struct Area fan3_area;
-	subarea(&area, &fan3_area, 18, 35, 15, 4);
+	get_stats(); // removes first run garbage
+	struct Stats stats = {};
 
+	// missed expirations are skipped, rates don't suffer from it,
+	// since they are calculated from the times the sources were read
+	for (;;) {
+		wait_timers(timers, 3);
+
+		if (sample_timer->expired) {
+			stats = get_stats();
+			push_screen(screen, &stats);
+		}
+
+		begin_outputs(outputs);
+		if (text_timer->expired)
+			render_text_screen(screen, &stats);
+		if (display_timer->expired)
+			render_screen(screen, &stats);
+		end_outputs(outputs);
+
+		if (display_timer->expired) {
+			struct Area areas[VIEWS];
+			struct Damage damage[VIEWS][DISPLAY_PAGES];
+			for (size_t id = 0; id < VIEWS; id++)
+				if (screen->views[id]) {
+					areas[id] = screen->views[id]->area;
+					take_damage_screen(screen, id, damage[id]);
+				}
+			draw_outputs(outputs, areas, damage);
+		}
+	}
+}
 
-	struct Ring cpu_ring;
-	alloc_ring(&cpu_ring, PLOT_WIDTH);
+// the rendered views and what changed since the previous frame
+struct Frame {
+	unsigned char buff[VIEWS][DISPLAY_PAGES * DISPLAY_WIDTH];
+	struct Damage damage[VIEWS][DISPLAY_PAGES];
+};
+
+struct Pipeline {
+	struct Screen* screen;
+	struct Outputs* outputs;
+	struct Timer** timers;
+	// sampler to renderer
+	struct Queue stats;
+	// renderer to writer
+	struct Queue frames;
+};
+
+void* run_sampler(void* arg) {
+	struct Pipeline* pipeline = arg;
+	struct Timer* sample_timer = pipeline->timers[0];
 
-	struct Ring cpu_tmp_ring;
-	alloc_ring(&cpu_tmp_ring, PLOT_WIDTH);
+	get_stats(); // removes first run garbage
 
-	struct Ring ram_tmp_ring;
-	alloc_ring(&ram_tmp_ring, PLOT_WIDTH);
+	for (;;) {
+		wait_timers(&sample_timer, 1);
 
-	struct Ring ram_ring;
-	alloc_ring(&ram_ring, PLOT_WIDTH);
+		struct Stats stats = get_stats();
+		struct Stats* slot = back_queue(&pipeline->stats);
+		if (!slot)
+			continue;
+		*slot = stats;
+		push_queue(&pipeline->stats);
+	}
+}
 
-	struct Ring net_rx_ring;
-	alloc_ring(&net_rx_ring, PLOT_WIDTH);
+void* run_renderer(void* arg) {
+	struct Pipeline* pipeline = arg;
+	struct Screen* screen = pipeline->screen;
+	struct Timer* timers[] = { pipeline->timers[1], pipeline->timers[2] };
+	struct Timer* display_timer = timers[0];
+	struct Timer* text_timer = timers[1];
 
-	struct Ring net_tx_ring;
-	alloc_ring(&net_tx_ring, PLOT_WIDTH);
+	struct Stats stats = {};
 
-	struct Ring disk_r_ring;
-	alloc_ring(&disk_r_ring, PLOT_WIDTH);
+	for (;;) {
+		wait_timers(timers, 2);
+
+		for (struct Stats* slot; (slot = front_queue(&pipeline->stats));) {
+			stats = *slot;
+			pop_queue(&pipeline->stats);
+			push_screen(screen, &stats);
+		}
+
+		begin_outputs(pipeline->outputs);
+		if (text_timer->expired)
+			render_text_screen(screen, &stats);
+		if (display_timer->expired)
+			render_screen(screen, &stats);
+		end_outputs(pipeline->outputs);
+
+		if (!display_timer->expired)
+			continue;
+
+		// the areas stay with the renderer, the writer gets copies,
+		// the damage of skipped frames is added to the next one
+		struct Frame* frame = back_queue(&pipeline->frames);
+		if (!frame)
+			continue;
+		for (size_t id = 0; id < VIEWS; id++)
+			if (screen->views[id]) {
+				memcpy(frame->buff[id], screen->views[id]->area.buff, sizeof(frame->buff[id]));
+				take_damage_screen(screen, id, frame->damage[id]);
+			}
+		push_queue(&pipeline->frames);
+	}
+}
 
-	struct Ring disk_w_ring;
-	alloc_ring(&disk_w_ring, PLOT_WIDTH);
+void* run_writer(void* arg) {
+	struct Pipeline* pipeline = arg;
+	struct Screen* screen = pipeline->screen;
 
-	
-	double next_update = get_time() + 1.0 / UPD_PER_SEC;
-	get_stats(); // removes first run garbage
+	struct Area areas[VIEWS];
+	for (size_t id = 0; id < VIEWS; id++)
+		if (screen->views[id])
+			areas[id] = screen->views[id]->area;
 
 	for (;;) {
-		if (!sleep_until(next_update))
-			errx(1, "failed to render frame in time");
-		next_update += 1.0 / UPD_PER_SEC;
+		wait_queue(&pipeline->frames);
 
-		struct Stats stats = get_stats();
+		struct Frame* frame = front_queue(&pipeline->frames);
+		for (size_t id = 0; id < VIEWS; id++)
+			areas[id].buff = frame->buff[id];
+		draw_outputs(pipeline->outputs, areas, frame->damage);
+		pop_queue(&pipeline->frames);
+	}
+}
+
+void run_pipelined(struct Screen* screen, struct Outputs* outputs, struct Timer** timers) {
+	struct Pipeline pipeline = {
+		.screen = screen,
+		.outputs = outputs,
+		.timers = timers,
+	};
+	// the renderer polls the stats when its timers expire
+	alloc_queue(&pipeline.stats, STATS_QUEUE, sizeof(struct Stats), false);
+	alloc_queue(&pipeline.frames, FRAME_QUEUE, sizeof(struct Frame), true);
+
+	pthread_t sampler, renderer;
+	if ((errno = pthread_create(&sampler, NULL, run_sampler, &pipeline)))
+		err(1, "failed to create sampler thread");
+	if ((errno = pthread_create(&renderer, NULL, run_renderer, &pipeline)))
+		err(1, "failed to create renderer thread");
+
+	run_writer(&pipeline);
+}
 
-		push_ring(&cpu_ring, stats.cpu);
-		push_ring(&cpu_tmp_ring, stats.cpu_tmp);
-		push_ring(&ram_tmp_ring, stats.ram_tmp);
-		push_ring(&ram_ring, stats.ram);
-		push_ring(&net_rx_ring, stats.net_rx);
-		push_ring(&net_tx_ring, stats.net_tx);
-		push_ring(&disk_r_ring, stats.disk_r);
-		push_ring(&disk_w_ring, stats.disk_w);
-
-		render_scalar(&cpu_scalar_area, stats.cpu * 100);
-		render_scalar(&cpu_tmp_scalar_area, stats.cpu_tmp);
-		render_scalar(&ram_tmp_scalar_area, stats.ram_tmp);
-		render_scalar(&ram_scalar_area, stats.ram * 100);
-
-		render_scalar_prefixed(&net_rx_scalar_area, stats.net_rx);
-		render_scalar_prefixed(&net_tx_scalar_area, stats.net_tx);
-		render_scalar_prefixed(&disk_r_scalar_area, stats.disk_r);
-		render_scalar_prefixed(&disk_w_scalar_area, stats.disk_w);
-
-		render_scalar(&uptime_days_area, stats.days);
-		render_scalar(&uptime_hours_area, stats.hours);
-		render_scalar(&uptime_minutes_area, stats.minutes);
-
-		render_scalar(&fan1_area, stats.fan1);
-		render_scalar(&fan2_area, stats.fan2);
-		render_scalar(&fan3_area, stats.fan3);
-
-		render_plot(&cpu_plot_area, &cpu_ring);
-		render_plot_fluct(&cpu_tmp_plot_area, &cpu_tmp_ring);
-		render_plot_fluct(&ram_tmp_plot_area, &ram_tmp_ring);
-		render_plot(&ram_plot_area, &ram_ring);
-		render_plot_norm(&net_rx_area, &net_rx_ring);
-		render_plot_norm(&net_tx_area, &net_tx_ring);
-		render_plot_norm(&disk_r_area, &disk_r_ring);
-		render_plot_norm(&disk_w_area, &disk_w_ring);
-
-		draw_display(display, &area);
+int main(int argc, char** argv) {
+	// history the plots are drawn from
+	enum Resolution resolution = RESOLUTION_SAMPLE;
+	enum Consolidation consolidation = CONSOLIDATION_MEAN;
+	// histories are kept in memory only without it
+	const char* state_path = NULL;
+	// how often counters are sampled, the display is refreshed and
+	// the uptime text is updated
+	double sample_rate = 1, display_rate = 1, text_rate = 1;
+	// the boards or ssd1306_emulators, the baud rates have to match them,
+	// or the other backends, each one shows a view, see init_output()
+	const char* output_specs[OUTPUTS] = { "/dev/ttyUSB0" };
+	size_t output_count = 0;
+	speed_t baud = 666666;
+	// sample, render and write in separate threads
+	bool pipelined = false;
+	// sources are read under the sysroot, recorded to or replayed from a log
+	const char* sysroot = NULL;
+	const char* record_path = NULL;
+	const char* replay_path = NULL;
+	// a folder of images replacing the built in ones, see init_render()
+	const char* assets_path = NULL;
+
+	for (int opt; (opt = getopt(argc, argv, "r:c:s:S:D:T:o:b:pR:W:P:a:")) != -1;) {
+		if (opt == 'r' && !strcmp(optarg, "sample"))
+			resolution = RESOLUTION_SAMPLE;
+		else if (opt == 'r' && !strcmp(optarg, "minute"))
+			resolution = RESOLUTION_MINUTE;
+		else if (opt == 'r' && !strcmp(optarg, "hour"))
+			resolution = RESOLUTION_HOUR;
+		else if (opt == 'c' && !strcmp(optarg, "min"))
+			consolidation = CONSOLIDATION_MIN;
+		else if (opt == 'c' && !strcmp(optarg, "max"))
+			consolidation = CONSOLIDATION_MAX;
+		else if (opt == 'c' && !strcmp(optarg, "mean"))
+			consolidation = CONSOLIDATION_MEAN;
+		else if (opt == 's')
+			state_path = optarg;
+		else if (opt == 'S')
+			sample_rate = parse_rate(optarg, argv[0]);
+		else if (opt == 'D')
+			display_rate = parse_rate(optarg, argv[0]);
+		else if (opt == 'T')
+			text_rate = parse_rate(optarg, argv[0]);
+		else if (opt == 'o' && output_count < OUTPUTS)
+			output_specs[output_count++] = optarg;
+		else if (opt == 'b')
+			baud = parse_baud(optarg, argv[0]);
+		else if (opt == 'p')
+			pipelined = true;
+		else if (opt == 'R')
+			sysroot = optarg;
+		else if (opt == 'W')
+			record_path = optarg;
+		else if (opt == 'P')
+			replay_path = optarg;
+		else if (opt == 'a')
+			assets_path = optarg;
+		else
+			usage(argv[0]);
+	}
+	if (optind != argc)
+		usage(argv[0]);
+	// the virtual clock is for a single thread
+	if (replay_path && (record_path || pipelined))
+		usage(argv[0]);
+
+	if (assets_path)
+		init_render(assets_path);
+	// the options of the outputs are parsed after -b
+	struct Outputs outputs = { .count = output_count ? output_count : 1 };
+	init_bus(&outputs.bus);
+	for (size_t i = 0; i < outputs.count; i++) {
+		init_output(outputs.list + i, output_specs[i], baud, &outputs.bus);
+		if (outputs.list[i].view >= VIEWS)
+			errx(1, "output `%s` shows view %zu of %d", output_specs[i], outputs.list[i].view, VIEWS);
+	}
+	// the boards boot at the same time
+	start_bus(&outputs.bus);
+
+	// after the output, since the board has to boot in real time
+	if (sysroot)
+		set_sysroot(sysroot);
+	if (record_path)
+		record_sources(record_path);
+	if (replay_path)
+		replay_sources(replay_path);
+
+	struct Screen screen;
+	init_screen(&screen, state_path, sample_rate, resolution, consolidation);
+	// views of the outputs that are rendered into are added first,
+	// so the other outputs of those views share the frames
+	for (size_t i = 0; i < outputs.count; i++) {
+		struct Output* output = outputs.list + i;
+		if (!frame_output(output))
+			continue;
+		if (screen.views[output->view])
+			errx(1, "output `%s` shows a view already rendered into shared memory", output_specs[i]);
+		add_view_screen(&screen, output->view, frame_output(output));
 	}
+	for (size_t i = 0; i < outputs.count; i++)
+		if (!screen.views[outputs.list[i].view])
+			add_view_screen(&screen, outputs.list[i].view, NULL);
+
+	struct Timer sample_timer, display_timer, text_timer;
+	init_timer(&sample_timer, sample_rate);
+	init_timer(&display_timer, display_rate);
+	init_timer(&text_timer, text_rate);
+	struct Timer* timers[] = { &sample_timer, &display_timer, &text_timer };
+
+	if (pipelined)
+		run_pipelined(&screen, &outputs, timers);
+	else
+		run_sequential(&screen, &outputs, timers);
 }
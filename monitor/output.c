@@ -0,0 +1,186 @@
+#include <ctype.h>
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "output.h"
+#include "pbm.h"
+
+void init_shared_output(struct Output* output) {
+	int fd = shm_open(output->path, O_RDWR | O_CREAT, 0644);
+	if (fd == -1)
+		err(1, "failed to open shared memory `%s`", output->path);
+	if (ftruncate(fd, sizeof(struct SharedFrame)))
+		err(1, "failed to resize shared memory `%s`", output->path);
+
+	output->shared = mmap(
+		NULL, sizeof(struct SharedFrame), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+	);
+	if (output->shared == MAP_FAILED)
+		err(1, "failed to map shared memory `%s`", output->path);
+	if (close(fd))
+		err(1, "failed to close shared memory `%s`", output->path);
+
+	// the frame is blank until the first one is rendered
+	struct SharedFrame* shared = output->shared;
+	memset(shared, 0, sizeof(*shared));
+	memcpy(shared->magic, SHARED_FRAME_MAGIC, sizeof(SHARED_FRAME_MAGIC));
+	shared->width = DISPLAY_WIDTH;
+	shared->height = DISPLAY_PAGES * 8;
+}
+
+// the number of a "name=number" option, false if it's another option
+bool parse_option_output(const char* option, const char* name, const char* spec, unsigned long* value) {
+	size_t len = strlen(name);
+	if (strncmp(option, name, len) || option[len] != '=')
+		return false;
+
+	char* end;
+	*value = strtoul(option + len + 1, &end, 10);
+	if (end == option + len + 1 || *end)
+		errx(1, "option `%s` of output `%s` isn't a number", option, spec);
+	return true;
+}
+
+bool parse_baud_output(const char* text, speed_t* baud) {
+	// strtoul takes a sign and wraps negative numbers around
+	if (!isdigit((unsigned char)*text))
+		return false;
+
+	char* end;
+	errno = 0;
+	unsigned long value = strtoul(text, &end, 10);
+	if (*end || errno || !value || value != (speed_t)value)
+		return false;
+	*baud = value;
+	return true;
+}
+
+void init_output(struct Output* output, const char* spec, speed_t baud, struct Bus* bus) {
+	// the options are cut off, the path points into the copy
+	char* copy = strdup(spec);
+	if (!copy)
+		err(1, "failed to allocate memory for output `%s`", spec);
+
+	output->view = 0;
+	char* options = strchr(copy, ',');
+	if (options)
+		*options++ = '\0';
+	for (char* option = options ? strtok(options, ",") : NULL; option; option = strtok(NULL, ",")) {
+		unsigned long value;
+		if (!strncmp(option, "baud=", strlen("baud="))) {
+			if (!parse_baud_output(option + strlen("baud="), &baud))
+				errx(1, "option `%s` of output `%s` isn't a baud rate", option, spec);
+		} else if (parse_option_output(option, "view", spec, &value))
+			output->view = value;
+		else
+			errx(1, "unknown option `%s` of output `%s`", option, spec);
+	}
+	spec = copy;
+
+	const char* prefixes[] = {
+		[BACKEND_SERIAL] = "serial:",
+		[BACKEND_PBM] = "pbm:",
+		[BACKEND_SHM] = "shm:",
+		[BACKEND_TERMINAL] = "terminal",
+	};
+
+	output->backend = BACKEND_SERIAL;
+	output->path = spec;
+	for (size_t i = 0; i < sizeof(prefixes) / sizeof(*prefixes); i++)
+		if (!strncmp(spec, prefixes[i], strlen(prefixes[i]))) {
+			output->backend = i;
+			output->path = spec + strlen(prefixes[i]);
+		}
+
+	if (output->backend == BACKEND_SERIAL) {
+		init_display(&output->display, output->path, baud);
+		add_bus(bus, &output->display);
+	} else if (output->backend == BACKEND_SHM) {
+		// names of shared memory objects start with a slash
+		if (output->path[0] != '/' || !output->path[1] || strchr(output->path + 1, '/'))
+			errx(1, "shared memory name `%s` isn't like `/name`", output->path);
+		init_shared_output(output);
+	} else if (output->backend == BACKEND_TERMINAL) {
+		output->cleared = false;
+	}
+}
+
+unsigned char* frame_output(struct Output* output) {
+	if (output->backend == BACKEND_SHM)
+		return output->shared->frame;
+	return NULL;
+}
+
+void begin_output(struct Output* output) {
+	if (output->backend != BACKEND_SHM)
+		return;
+	uint64_t* sequence = &output->shared->sequence;
+	__atomic_store_n(sequence, *sequence | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void end_output(struct Output* output) {
+	if (output->backend != BACKEND_SHM)
+		return;
+	uint64_t* sequence = &output->shared->sequence;
+	__atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELEASE);
+}
+
+// braille dots are numbered down the left column and then the right one,
+// the bottom row came later and got the high bits
+const unsigned char braille_dots[4][2] = {
+	{ 0x01, 0x08 },
+	{ 0x02, 0x10 },
+	{ 0x04, 0x20 },
+	{ 0x40, 0x80 },
+};
+
+void draw_terminal(struct Output* output, const struct Area* area) {
+	// a cell is 3 bytes of utf-8, every row ends with a newline
+	char text[(area->width + 1) / 2 * 3 * ((area->height + 3) / 4) + (area->height + 3) / 4 + 16];
+	size_t len = 0;
+
+	const char* home = output->cleared ? "\x1b[H" : "\x1b[H\x1b[2J";
+	output->cleared = true;
+	len += sprintf(text, "%s", home);
+
+	for (size_t y = 0; y < area->height; y += 4) {
+		for (size_t x = 0; x < area->width; x += 2) {
+			unsigned char dots = 0;
+			for (size_t dy = 0; dy < 4 && y + dy < area->height; dy++)
+				for (size_t dx = 0; dx < 2 && x + dx < area->width; dx++)
+					if (get_area(area, x + dx, y + dy))
+						dots |= braille_dots[dy][dx];
+
+			// U+2800 + dots
+			text[len++] = 0xE2;
+			text[len++] = 0xA0 | dots >> 6;
+			text[len++] = 0x80 | (dots & 0x3F);
+		}
+		text[len++] = '\n';
+	}
+
+	for (size_t written = 0; written < len;) {
+		ssize_t w = write(STDOUT_FILENO, text + written, len - written);
+		if (w == -1)
+			err(1, "failed to write to the terminal");
+		written += w;
+	}
+}
+
+void draw_output(struct Output* output, const struct Area* area, const struct Damage* damage) {
+	if (output->backend == BACKEND_SERIAL)
+		draw_display(&output->display, area, damage);
+	else if (output->backend == BACKEND_PBM)
+		save_frame_pbm(output->path, area->buff, area->stride, area->height);
+	else if (output->backend == BACKEND_SHM)
+		__atomic_add_fetch(&output->shared->drawn, 1, __ATOMIC_RELEASE);
+	else if (output->backend == BACKEND_TERMINAL)
+		draw_terminal(output, area);
+}
@@ -0,0 +1,71 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "area.h"
+#include "display.h"
+
+enum Backend {
+	// the board, see display.h
+	BACKEND_SERIAL,
+	// every frame replaces a pbm file
+	BACKEND_PBM,
+	// the frame is rendered straight into shared memory
+	BACKEND_SHM,
+	// unicode braille on stdout, a cell is 2 by 4 pixels
+	BACKEND_TERMINAL,
+};
+
+// what other processes see in the shared memory,
+// the frame is in the ssd1306 page-major layout, see area.h
+struct SharedFrame {
+	char magic[8];
+	uint32_t width;
+	uint32_t height;
+	// odd while the frame is being rendered, readers retry if it changed
+	uint64_t sequence;
+	// incremented every time the frame is drawn
+	uint64_t drawn;
+	unsigned char frame[DISPLAY_PAGES * DISPLAY_WIDTH];
+};
+
+#define SHARED_FRAME_MAGIC "ssd1306"
+
+struct Output {
+	enum Backend backend;
+	const char* path;
+	// which of the layouts of the screen is shown, see enum ViewId
+	size_t view;
+	// BACKEND_SERIAL
+	struct Display display;
+	// BACKEND_SHM
+	struct SharedFrame* shared;
+	// BACKEND_TERMINAL, the screen is cleared before the first frame
+	bool cleared;
+};
+
+// a whole number of bits per second that fits speed_t, false if it isn't one
+bool parse_baud_output(const char* text, speed_t* baud);
+
+// spec is one of "serial:<device>", "pbm:<path>", "shm:<name>" or "terminal",
+// anything else is taken as a serial device, options follow a comma,
+// e.g. "serial:/dev/ttyUSB1,baud=115200,view=1", baud is the default one,
+// serial displays are added to the bus
+void init_output(struct Output* output, const char* spec, speed_t baud, struct Bus* bus);
+
+// since the program will never stop and free it's resources, there is no free_output()
+
+// memory the frame has to be rendered into or NULL if any will do
+unsigned char* frame_output(struct Output* output);
+
+// rendering into the frame happens between these
+void begin_output(struct Output* output);
+void end_output(struct Output* output);
+
+// damage is what changed since the previous frame, see pack_display(),
+// serial displays are only written by flush_bus()
+void draw_output(struct Output* output, const struct Area* area, const struct Damage* damage);
+
+#endif
@@ -0,0 +1,59 @@
+#include <assert.h>
+#include <err.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "queue.h"
+
+void alloc_queue(struct Queue* queue, size_t capacity, size_t size, bool blocking) {
+	if (!(queue->buff = calloc(capacity, size)))
+		err(1, "failed to allocate memory for queue");
+	queue->size = size;
+	queue->capacity = capacity;
+	queue->head = 0;
+	queue->tail = 0;
+
+	queue->event = -1;
+	if (blocking && (queue->event = eventfd(0, EFD_CLOEXEC)) == -1)
+		err(1, "failed to create eventfd for queue");
+}
+
+void* back_queue(struct Queue* queue) {
+	size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+	if (queue->tail - head == queue->capacity)
+		return NULL;
+	return queue->buff + queue->tail % queue->capacity * queue->size;
+}
+
+void push_queue(struct Queue* queue) {
+	__atomic_store_n(&queue->tail, queue->tail + 1, __ATOMIC_RELEASE);
+	if (queue->event == -1)
+		return;
+
+	uint64_t one = 1;
+	if (write(queue->event, &one, sizeof(one)) == -1)
+		err(1, "failed to signal queue");
+}
+
+void* front_queue(struct Queue* queue) {
+	size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+	if (tail == queue->head)
+		return NULL;
+	return queue->buff + queue->head % queue->capacity * queue->size;
+}
+
+void pop_queue(struct Queue* queue) {
+	__atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+}
+
+void wait_queue(struct Queue* queue) {
+	assert(queue->event != -1);
+	while (!front_queue(queue)) {
+		uint64_t count;
+		if (read(queue->event, &count, sizeof(count)) == -1 && errno != EINTR)
+			err(1, "failed to wait for queue");
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// lock-free single producer single consumer queue of fixed size elements,
+// elements are filled and read in place, the consumer can block on event
+struct Queue {
+	char* buff;
+	size_t size;
+	size_t capacity;
+	// only ever increase, written by the consumer and the producer respectively
+	size_t head;
+	size_t tail;
+	// eventfd signaled on every push, -1 if the consumer only polls
+	int event;
+};
+
+// without blocking the consumer can't wait_queue(), but pushes cost no syscall
+void alloc_queue(struct Queue* queue, size_t capacity, size_t size, bool blocking);
+
+// since the program will never stop and free it's resources, there is no free_queue()
+
+// producer side, returns the element to fill or NULL if the queue is full
+void* back_queue(struct Queue* queue);
+
+// publishes the element returned by back_queue()
+void push_queue(struct Queue* queue);
+
+// consumer side, returns the oldest element or NULL if the queue is empty
+void* front_queue(struct Queue* queue);
+
+// releases the element returned by front_queue()
+void pop_queue(struct Queue* queue);
+
+// blocks until the queue isn't empty
+void wait_queue(struct Queue* queue);
+
+#endif
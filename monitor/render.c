@@ -1,48 +1,116 @@
 #include <assert.h>
+#include <err.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/types.h>
-#include <math.h>
 
 #include "render.h"
+#include "assets.h"
 
-struct Bitmap digits[10];
-struct Bitmap prefixes[4];
+#define ASSET(name, NAME) { asset_##name, ASSET_##NAME##_WIDTH, ASSET_##NAME##_HEIGHT }
 
-void render_bitmap(struct Area* area, struct Bitmap* bitmap) {
-	assert(bitmap);
+// built in, init_render() replaces them
+struct Glyph digits[10] = {
+	ASSET(0, 0), ASSET(1, 1), ASSET(2, 2), ASSET(3, 3), ASSET(4, 4),
+	ASSET(5, 5), ASSET(6, 6), ASSET(7, 7), ASSET(8, 8), ASSET(9, 9),
+};
+struct Glyph prefixes[4] = {
+	ASSET(bs, BS), ASSET(kibs, KIBS), ASSET(mibs, MIBS), ASSET(gibs, GIBS),
+};
+struct Glyph template = ASSET(template, TEMPLATE);
+
+void render_bitmap(struct Area* area, const struct Bitmap* bitmap) {
 	assert(bitmap->buff);
 	assert(area->width == bitmap->width);
 	assert(area->height == bitmap->height);
 	for (size_t y = 0; y < area->height; y++)
 		for (size_t x = 0; x < area->width; x++)
-			set_area(area, x, y, bitmap->buff[y][x]);
+			set_area(area, x, y, get_pbm(bitmap, x, y));
 }
 
-// area must be 4 by 4*n-1
-void render_scalar(struct Area* area, unsigned int value) {
-	assert((area->width + 1) % 4 == 0);
-	assert(area->height == 4);
-	assert(digits);
+// ors a glyph of a single page into the area at x, the rows of the glyph
+// are shifted into the page of the area's top and the one after it
+static inline void blit_glyph(struct Area* area, size_t x, const struct Glyph* glyph) {
+	assert(glyph->height <= 8 && glyph->height <= area->height);
+	assert(x + glyph->width <= area->width);
 
-	size_t maxn = (area->width + 1) / 4;
-	assert(value / (int)pow(10, maxn) == 0);
+	size_t shift = area->y_offset % 8;
+	unsigned char* top = area->buff + area->y_offset / 8 * area->stride + area->x_offset + x;
+	for (size_t i = 0; i < glyph->width; i++)
+		top[i] |= glyph->buff[i] << shift;
 
-	clear_area(area);
+	if (shift + glyph->height > 8) {
+		unsigned char* bottom = top + area->stride;
+		for (size_t i = 0; i < glyph->width; i++)
+			bottom[i] |= glyph->buff[i] >> (8 - shift);
+	}
+}
+
+void render_glyph(struct Area* area, const struct Glyph* glyph) {
+	assert(area->width == glyph->width);
+	assert(area->height == glyph->height);
 
-	if (value == 0) {
-		struct Area digit_area;
-		subarea(area, &digit_area, area->width - 3, 0, 3, 4);
-		render_bitmap(&digit_area, digits);
+	if (glyph->height <= 8) {
+		clear_area(area);
+		blit_glyph(area, 0, glyph);
 		return;
 	}
 
-	for (ssize_t n = maxn - 1; n >= 0; n--) {
-		struct Area digit_area;
-		subarea(area, &digit_area, n * 4, 0, 3, 4);
-		if (value)
-			render_bitmap(&digit_area, digits + (value % 10));
-		value /= 10;
+	// whole pages are copied as they are
+	if (area->y_offset % 8 == 0 && area->height % 8 == 0) {
+		for (size_t page = 0; page < area->height / 8; page++)
+			memcpy(
+				area->buff + (area->y_offset / 8 + page) * area->stride + area->x_offset,
+				glyph->buff + page * glyph->width,
+				glyph->width
+			);
+		return;
 	}
+
+	for (size_t y = 0; y < area->height; y++)
+		for (size_t x = 0; x < area->width; x++)
+			set_area(area, x, y, glyph->buff[y / 8 * glyph->width + x] >> y % 8 & 1);
+}
+
+void render_template(struct Area* area) {
+	render_glyph(area, &template);
+}
+
+// the tens and the ones of every number below 100,
+// so numbers are split two digits at a time
+#define PAIRS(tens) \
+	{ tens, 0 }, { tens, 1 }, { tens, 2 }, { tens, 3 }, { tens, 4 }, \
+	{ tens, 5 }, { tens, 6 }, { tens, 7 }, { tens, 8 }, { tens, 9 }
+static const unsigned char digit_pairs[100][2] = {
+	PAIRS(0), PAIRS(1), PAIRS(2), PAIRS(3), PAIRS(4),
+	PAIRS(5), PAIRS(6), PAIRS(7), PAIRS(8), PAIRS(9),
+};
+
+static const unsigned long long powers_of_ten[] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+	10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+};
+
+// ors the number into n digits at the left of the area aligned to the right,
+// the area has to be clear
+static void blit_number(struct Area* area, size_t n, unsigned long long value) {
+	assert(n >= sizeof(powers_of_ten) / sizeof(*powers_of_ten) || value < powers_of_ten[n]);
+	do {
+		const unsigned char* pair = digit_pairs[value % 100];
+		value /= 100;
+		blit_glyph(area, --n * 4, digits + pair[1]);
+		if (value || pair[0])
+			blit_glyph(area, --n * 4, digits + pair[0]);
+	} while (value);
+}
+
+// area must be 4 by 4*n-1
+void render_scalar(struct Area* area, unsigned int value) {
+	assert((area->width + 1) % 4 == 0);
+	assert(area->height == 4);
+
+	clear_area(area);
+	blit_number(area, (area->width + 1) / 4, value);
 }
 
 // area must be 4 by 33
@@ -51,124 +119,212 @@ void render_scalar_prefixed(struct Area* area, unsigned long long value) {
 	assert(area->width == 33);
 	assert(area->height == 4);
 
-	clear_area(area);
-	ssize_t p = 0;
+	size_t p = 0;
 	while (value > 1024) {
-		value /= 1024;
+		value >>= 10;
 		p++;
 	}
-
 	assert(p <= 3);
 
-	struct Area scalar_area;
-	subarea(area, &scalar_area, 0, 0, 15, 4);
-	render_scalar(&scalar_area, value);
+	clear_area(area);
+	blit_number(area, 4, value);
+	blit_glyph(area, 16, prefixes + p);
+}
 
-	struct Bitmap* prefix = prefixes + p;
-	struct Area prefix_area;
-	subarea(area, &prefix_area, 16, 0, prefix->width, 4);
-	render_bitmap(&prefix_area, prefix);
+// the row of every value of the ring, oldest first, from 0 at the bottom to height - 1,
+// values are mapped to (value - offset) / range, which should be in [0:1],
+// with zero range everything is mapped to zero, both contiguous parts of the ring
+// are walked in a straight loop, which the compiler vectorises
+static void quantize_plot(
+		const struct Ring* ring,
+		double offset,
+		double range,
+		size_t height,
+		int32_t* rows
+) {
+	size_t first = ring->capacity - ring->begin;
+	if (first > ring->length)
+		first = ring->length;
+	const double* parts[] = { ring->buff + ring->begin, ring->buff };
+	size_t lengths[] = { first, ring->length - first };
+
+	if (!range) {
+		memset(rows, 0, ring->length * sizeof(*rows));
+		return;
+	}
+
+	int32_t top = height - 1;
+	for (size_t p = 0; p < 2; p++) {
+		const double* values = parts[p];
+		for (size_t i = 0; i < lengths[p]; i++) {
+			int32_t row = (values[i] - offset) / range * height;
+			row = row < 0 ? 0 : row;
+			rows[i] = row > top ? top : row;
+		}
+		rows += lengths[p];
+	}
 }
 
-// values in the ring must be normalized to [0:1]
-void render_plot(
-		struct Area* area, 
-		const struct Ring* ring
+// bits of the rows from low to high of a column, the top row is the lowest bit
+static inline uint64_t span_plot(size_t height, int32_t low, int32_t high) {
+	if (low > high) {
+		int32_t swap = low;
+		low = high;
+		high = swap;
+	}
+	return ((2ull << (high - low)) - 1) << (height - 1 - high);
+}
+
+void render_plot_styled(
+		struct Area* area,
+		const struct Ring* ring,
+		const struct Ring* upper,
+		enum PlotScale scale,
+		enum PlotStyle style
 ) {
 	assert(ring->capacity == area->width);
+	assert(area->height && area->height <= PLOT_MAX_HEIGHT);
+	if (style != PLOT_ENVELOPE || !upper)
+		upper = ring;
+	assert(upper->length == ring->length);
 
-	clear_area(area);
-	for (size_t i = 0; i < ring->length; i++) {
-		double value = get_ring(ring, ring->length - 1 - i);
-		assert(0 <= value && value <= 1);
+	double offset = 0, range = 1;
+	if (scale != PLOT_UNIT) {
+		double min = 0, max = 0, upper_min, upper_max;
+		if (ring->length) {
+			get_extremes_ring(ring, &min, &max);
+			if (upper != ring) {
+				get_extremes_ring(upper, &upper_min, &upper_max);
+				max = upper_max;
+			}
+		}
+		assert(0 <= min);
+		offset = scale == PLOT_FLUCT ? min : 0;
+		range = max - offset;
+	}
 
-		/*
-		area->height == 5
-		[4:5] -> 4
-		[3:4) -> 3
-		[2:3) -> 2
-		[1:2) -> 1
-		[0:1) -> 0
-		*/
-		value = value * area->height;
-		if (value == area->height)
-			value--;
-
-		for (ssize_t h = value; h >= 0; h--) 
-			set_area(
-				area, 
-				area->width - 1 - i, 
-				area->height - 1 - h,
-				true
-			);
+	size_t length = ring->length;
+	int32_t rows[length ? length : 1], upper_rows[length ? length : 1];
+	quantize_plot(ring, offset, range, area->height, rows);
+	if (upper != ring)
+		quantize_plot(upper, offset, range, area->height, upper_rows);
+
+	// every column of the area, shifted to the first page it covers
+	size_t shift = area->y_offset % 8;
+	uint64_t columns[area->width];
+	size_t empty = area->width - length;
+	for (size_t x = 0; x < empty; x++)
+		columns[x] = 0;
+	for (size_t i = 0; i < length; i++) {
+		uint64_t bits;
+		if (style == PLOT_BARS)
+			bits = span_plot(area->height, 0, rows[i]);
+		else if (style == PLOT_LINE)
+			bits = span_plot(area->height, i ? rows[i - 1] : rows[i], rows[i]);
+		else
+			bits = span_plot(area->height, rows[i], upper_rows[i]);
+		columns[empty + i] = bits << shift;
+	}
+
+	uint64_t mask = ((1ull << area->height) - 1) << shift;
+	unsigned char* first = area->buff + area->y_offset / 8 * area->stride + area->x_offset;
+	for (size_t page = 0; page * 8 < shift + area->height; page++) {
+		unsigned char* row = first + page * area->stride;
+		unsigned char keep = ~(mask >> page * 8);
+		for (size_t x = 0; x < area->width; x++)
+			row[x] = (row[x] & keep) | (unsigned char)(columns[x] >> page * 8);
 	}
 }
 
-void render_plot_norm(
+// values in the ring must be normalized to [0:1]
+void render_plot(
 		struct Area* area, 
 		const struct Ring* ring
 ) {
-	double tmp[ring->capacity];
-	struct Ring norm_ring = {
-		.buff = tmp,
-		.capacity = ring->capacity,
-		.begin = 0, 
-		.length = 0,
-	};
-
-	double max = 0;
-	for (size_t i = 0; i < ring->length; i++) {
-		double value = get_ring(ring, i);
-		assert(0 <= value);
-		if (value > max)
-			max = value;
-	}
-
-	for (size_t i = 0; i < ring->length; i++) {
-		double value = max ? get_ring(ring, i) / max : 0;
-		push_ring(&norm_ring, value);
-	}
+	render_plot_styled(area, ring, NULL, PLOT_UNIT, PLOT_BARS);
+}
 
-	render_plot(area, &norm_ring);
+void render_plot_norm(
+		struct Area* area, 
+		const struct Ring* ring
+) {
+	render_plot_styled(area, ring, NULL, PLOT_NORM, PLOT_BARS);
 }
 
 void render_plot_fluct(
 		struct Area* area, 
 		const struct Ring* ring
 ) {
-	double tmp[ring->capacity];
-	struct Ring fluct_ring = {
-		.buff = tmp,
-		.capacity = ring->capacity,
-		.begin = 0, 
-		.length = 0,
-	};
-
-	double min = INFINITY, max = 0;
-	for (size_t i = 0; i < ring->length; i++) {
-		double value = get_ring(ring, i);
-		assert(0 <= value);
-		if (value > max)
-			max = value;
-		if (value < min)
-			min = value;
+	render_plot_styled(area, ring, NULL, PLOT_FLUCT, PLOT_BARS);
+}
+
+// 4 by 4 ordered dithering thresholds
+const unsigned char bayer[4][4] = {
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 },
+};
+
+size_t quantize_heatmap(
+		const struct Area* area,
+		const double* values,
+		size_t count,
+		unsigned char* levels
+) {
+	size_t cells = count;
+	if (cells > area->width * area->height)
+		cells = area->width * area->height;
+
+	for (size_t i = 0; i < cells; i++) {
+		size_t first = i * count / cells, last = (i + 1) * count / cells;
+		double value = 0;
+		for (size_t j = first; j < last; j++)
+			value += values[j];
+		value /= last - first;
+		assert(0 <= value && value <= 1);
+		levels[i] = value * 16 + 0.5;
 	}
-	assert(min != INFINITY);
-	max -= min;
+	return cells;
+}
 
-	for (size_t i = 0; i < ring->length; i++) {
-		double value;
-		if (min == max || max == 0)
-			value = 0;
-		else
-			value = (get_ring(ring, i) - min) / max;
-		push_ring(&fluct_ring, value);
+void render_heatmap_levels(
+		struct Area* area,
+		const unsigned char* levels,
+		size_t cells
+) {
+	clear_area(area);
+	if (!cells)
+		return;
+
+	size_t cols = cells < area->width ? cells : area->width;
+	size_t rows = (cells + cols - 1) / cols;
+	size_t cell_width = area->width / cols;
+	size_t cell_height = area->height / rows;
+
+	// gaps between cells if they are wide enough
+	size_t fill_width = cell_width >= 3 ? cell_width - 1 : cell_width;
+
+	for (size_t i = 0; i < cells; i++) {
+		// the pattern is aligned to the area, so tiny cells dither as a whole
+		size_t cell_x = i % cols * cell_width, cell_y = i / cols * cell_height;
+		for (size_t y = cell_y; y < cell_y + cell_height; y++)
+			for (size_t x = cell_x; x < cell_x + fill_width; x++)
+				set_area(area, x, y, bayer[y % 4][x % 4] < levels[i]);
 	}
+}
 
-	render_plot(area, &fluct_ring);
+void render_heatmap(
+		struct Area* area,
+		const double* values,
+		size_t count
+) {
+	unsigned char levels[area->width * area->height];
+	size_t cells = quantize_heatmap(area, values, count, levels);
+	render_heatmap_levels(area, levels, cells);
 }
 
-struct Bitmap init_bitmap(const char* path, const char* name, size_t width, size_t height) {
+struct Glyph load_glyph(const char* path, const char* name, size_t width, size_t height) {
 	size_t path_len = strlen(path);
 	size_t name_len = strlen(name);
 	char full_path[path_len + 1 + name_len + 1];
@@ -177,23 +333,26 @@ struct Bitmap init_bitmap(const char* path, const char* name, size_t width, size
 	full_path[path_len] = '/';
 	memcpy(full_path + path_len + 1, name, name_len + 1);
 
-	return load_exp_pbm(full_path, width, height);
+	struct Bitmap bitmap = load_exp_pbm(full_path, width, height);
+	unsigned char* buff = malloc(PACKED_SIZE(width, height));
+	if (!buff)
+		err(1, "failed to allocate memory for `%s`", full_path);
+	pack_pbm(&bitmap, buff);
+	free_pbm(&bitmap);
+
+	return (struct Glyph) { .buff = buff, .width = width, .height = height };
 }
 
-// path must point to a folder with:
-// 10 images named "0.pbm", "1.pbm", ..., "9.pbm" of size 3 by 4
-// and images named "bs.pbm", "kibs.pbm", "mibs.pbm" and "gibs.pbm" of sizes
-// 9 by 4, 15 by 4, 17 by 4 and 15 by 4 respectively
 void init_render(const char* path) {
 	char digit_name[] = " .pbm";
 	for (size_t i = 0; i < 10; i++) {
 		digit_name[0] = '0' + i;
-		digits[i] = init_bitmap(path, digit_name, 3, 4);
+		digits[i] = load_glyph(path, digit_name, 3, 4);
 	}
 
-	prefixes[0] = init_bitmap(path, "bs.pbm", 9, 4);
-	prefixes[1] = init_bitmap(path, "kibs.pbm", 15, 4);
-	prefixes[2] = init_bitmap(path, "mibs.pbm", 17, 4);
-	prefixes[3] = init_bitmap(path, "gibs.pbm", 15, 4);
+	prefixes[0] = load_glyph(path, "bs.pbm", 9, 4);
+	prefixes[1] = load_glyph(path, "kibs.pbm", 15, 4);
+	prefixes[2] = load_glyph(path, "mibs.pbm", 17, 4);
+	prefixes[3] = load_glyph(path, "gibs.pbm", 15, 4);
+	template = load_glyph(path, "template.pbm", 128, 64);
 }
-
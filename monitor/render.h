@@ -5,15 +5,29 @@
 #include "area.h"
 #include "ring.h"
 
-// path must point to a folder with:
-// 10 images named "0.pbm", "1.pbm", ..., "9.pbm" of size 3 by 4
-// and images named "bs.pbm", "kibs.pbm", "mibs.pbm" and "gibs.pbm" of sizes
+// pixels packed in the ssd1306 page-major layout, see area.h
+struct Glyph {
+	const unsigned char* buff;
+	size_t width;
+	size_t height;
+};
+
+// the images of bitmaps/ are built in, this replaces them with the ones in path,
+// which must point to a folder with:
+// 10 images named "0.pbm", "1.pbm", ..., "9.pbm" of size 3 by 4,
+// images named "bs.pbm", "kibs.pbm", "mibs.pbm" and "gibs.pbm" of sizes
 // 9 by 4, 15 by 4, 17 by 4 and 15 by 4 respectively
+// and "template.pbm" of size 128 by 64
 void init_render(const char* path);
 
 // since the program will never stop and free it's resources, there is no free_render()
 
-void render_bitmap(struct Area* area, struct Bitmap* bitmap);
+void render_bitmap(struct Area* area, const struct Bitmap* bitmap);
+
+void render_glyph(struct Area* area, const struct Glyph* glyph);
+
+// the labels of the screen, area must be 128 by 64
+void render_template(struct Area* area);
 
 // area must be 4 by 4*n-1
 void render_scalar(struct Area* area, unsigned int value);
@@ -22,12 +36,47 @@ void render_scalar(struct Area* area, unsigned int value);
 // value souldn't be greater or equal to 1024^4
 void render_scalar_prefixed(struct Area* area, unsigned long long value);
 
+enum PlotScale {
+	// values are already in [0:1]
+	PLOT_UNIT,
+	// from zero to the maximum
+	PLOT_NORM,
+	// from the minimum to the maximum
+	PLOT_FLUCT,
+};
+
+enum PlotStyle {
+	// every column is filled from the bottom to its value
+	PLOT_BARS,
+	// every column spans from the previous value to its own
+	PLOT_LINE,
+	// every column spans from the value in ring to the one in upper
+	PLOT_ENVELOPE,
+};
+
+// taller plots don't fit the columns the engine works with
+#define PLOT_MAX_HEIGHT 56
+
+// the plot engine, a ring's values are scaled to rows at once and every
+// column is written as a mask into the pages, upper is read only by PLOT_ENVELOPE,
+// it's scaled together with ring and must be as long as it, e.g. the maximums
+// of a tier with ring being its minimums, with NULL upper it's ring
+void render_plot_styled(
+		struct Area* area,
+		const struct Ring* ring,
+		const struct Ring* upper,
+		enum PlotScale scale,
+		enum PlotStyle style
+);
+
 // values in the ring must be normalized to [0:1]
 void render_plot(
 		struct Area* area, 
 		const struct Ring* ring
 );
 
+// tracked rings are normalized without scanning the values
+
 void render_plot_norm(
 		struct Area* area, 
 		const struct Ring* ring
@@ -38,4 +87,27 @@ void render_plot_fluct(
 		const struct Ring* ring
 );
 
+// values must be normalized to [0:1], each one is a dithered cell,
+// when there are more values than pixels they are averaged
+void render_heatmap(
+		struct Area* area,
+		const double* values,
+		size_t count
+);
+
+// render_heatmap() in two steps, so the levels can be compared to the drawn ones,
+// levels must have room for the pixels of the area, the number of cells is returned
+size_t quantize_heatmap(
+		const struct Area* area,
+		const double* values,
+		size_t count,
+		unsigned char* levels
+);
+
+void render_heatmap_levels(
+		struct Area* area,
+		const unsigned char* levels,
+		size_t cells
+);
+
 #endif
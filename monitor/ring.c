@@ -1,26 +1,122 @@
-#include <stdlib.h>
 #include <assert.h>
-#include <err.h>
 
 #include "ring.h"
 
-void alloc_ring(struct Ring* ring, size_t capacity) {
-	if (!(ring->buff = calloc(capacity, sizeof(double))))
-		err(1, "failed to allocate memory for ring");
+void alloc_ring_in(struct Ring* ring, size_t capacity, struct Arena* arena) {
+	ring->buff = alloc_arena(arena, capacity, sizeof(double));
 	ring->capacity = capacity;
 	ring->begin = 0;
 	ring->length = 0;
+	ring->pushed = 0;
+	ring->tracked = false;
+}
+
+void alloc_ring(struct Ring* ring, size_t capacity) {
+	alloc_ring_in(ring, capacity, NULL);
+}
+
+void alloc_deque(struct Deque* deque, size_t capacity, struct Arena* arena) {
+	deque->buff = alloc_arena(arena, capacity, sizeof(size_t));
+	deque->begin = 0;
+	deque->length = 0;
+}
+
+void alloc_tracked_ring_in(struct Ring* ring, size_t capacity, struct Arena* arena) {
+	alloc_ring_in(ring, capacity, arena);
+	alloc_deque(&ring->min, capacity, arena);
+	alloc_deque(&ring->max, capacity, arena);
+	ring->tracked = true;
+}
+
+// a nonempty ring has its extreme at the front
+bool check_deque(const struct Deque* deque, const struct Ring* ring) {
+	return deque->begin < ring->capacity && deque->length <= ring->length && (deque->length || !ring->length);
+}
+
+bool rebind_tracked_ring_in(struct Ring* ring, size_t capacity, struct Arena* arena) {
+	ring->buff = take_arena(arena, capacity, sizeof(double));
+	ring->min.buff = take_arena(arena, capacity, sizeof(size_t));
+	ring->max.buff = take_arena(arena, capacity, sizeof(size_t));
+	return ring->capacity == capacity && ring->tracked &&
+		ring->begin < capacity && ring->length <= capacity && ring->pushed >= ring->length &&
+		check_deque(&ring->min, ring) && check_deque(&ring->max, ring);
+}
+
+void alloc_tracked_ring(struct Ring* ring, size_t capacity) {
+	alloc_tracked_ring_in(ring, capacity, NULL);
 }
 
 double get_ring(const struct Ring* ring, size_t index) {
 	assert(index < ring->length);
-	return ring->buff[(ring->begin + index) % ring->length];
+	return ring->buff[(ring->begin + index) % ring->capacity];
+}
+
+// the value at a position is where it was pushed, until it's overwritten
+double get_position(const struct Ring* ring, size_t position) {
+	return ring->buff[position % ring->capacity];
+}
+
+size_t front_deque(const struct Deque* deque, size_t capacity) {
+	assert(deque->length);
+	return deque->buff[deque->begin % capacity];
+}
+
+size_t back_deque(const struct Deque* deque, size_t capacity) {
+	assert(deque->length);
+	return deque->buff[(deque->begin + deque->length - 1) % capacity];
+}
+
+// removes the positions that are no longer in the ring and the ones
+// that can never become the extreme, since the new value is better
+void update_deque(struct Ring* ring, struct Deque* deque, double value, bool is_min) {
+	size_t position = ring->pushed;
+
+	if (deque->length && front_deque(deque, ring->capacity) + ring->capacity <= position) {
+		deque->begin = (deque->begin + 1) % ring->capacity;
+		deque->length--;
+	}
+
+	while (deque->length) {
+		double back = get_position(ring, back_deque(deque, ring->capacity));
+		if (is_min ? back < value : back > value)
+			break;
+		deque->length--;
+	}
+
+	assert(deque->length < ring->capacity);
+	deque->buff[(deque->begin + deque->length) % ring->capacity] = position;
+	deque->length++;
 }
 
 void push_ring(struct Ring* ring, double value) {
+	if (ring->tracked) {
+		update_deque(ring, &ring->min, value, true);
+		update_deque(ring, &ring->max, value, false);
+	}
+
 	ring->buff[(ring->begin + ring->length) % ring->capacity] = value;
 	if (ring->length < ring->capacity)
 		ring->length++;
 	else
 		ring->begin = (ring->begin + 1) % ring->capacity;
+	ring->pushed++;
+}
+
+void get_extremes_ring(const struct Ring* ring, double* min, double* max) {
+	assert(ring->length);
+
+	if (ring->tracked) {
+		*min = get_position(ring, front_deque(&ring->min, ring->capacity));
+		*max = get_position(ring, front_deque(&ring->max, ring->capacity));
+		return;
+	}
+
+	*min = *max = get_ring(ring, 0);
+	for (size_t i = 1; i < ring->length; i++) {
+		double value = get_ring(ring, i);
+		if (value < *min)
+			*min = value;
+		if (value > *max)
+			*max = value;
+	}
 }
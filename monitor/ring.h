@@ -2,20 +2,54 @@
 #define RING_H
 
 #include <stddef.h>
+#include <stdbool.h>
+
+#include "arena.h"
+
+// positions of candidates for the extreme, the front one is the extreme
+struct Deque {
+	size_t* buff;
+	size_t begin;
+	size_t length;
+};
 
 struct Ring {
 	double* buff;
 	size_t capacity;
 	size_t begin;
 	size_t length;
+	// number of values ever pushed, the position of a value
+	size_t pushed;
+	// monotonic deques are maintained only if the ring is tracked
+	bool tracked;
+	struct Deque min;
+	struct Deque max;
 };
 
 void alloc_ring(struct Ring* ring, size_t capacity);
 
+// also keeps track of minimum and maximum values in amortized O(1) per push
+void alloc_tracked_ring(struct Ring* ring, size_t capacity);
+
+// same as alloc_tracked_ring, but the memory is taken from the arena
+void alloc_tracked_ring_in(struct Ring* ring, size_t capacity, struct Arena* arena);
+
+// points a tracked ring, whose values are already in the arena, to them,
+// the arena must hand out the same offsets as when it was allocated,
+// false if the ring isn't a tracked one of the capacity, e.g. it's corrupt
+bool rebind_tracked_ring_in(struct Ring* ring, size_t capacity, struct Arena* arena);
+
+// arena space taken by a tracked ring
+#define TRACKED_RING_SIZE(capacity) \
+	(ARENA_SIZE(capacity, sizeof(double)) + 2 * ARENA_SIZE(capacity, sizeof(size_t)))
+
 // since the program will never stop and free it's resources, there is no free_ring()
 
 double get_ring(const struct Ring* ring, size_t index);
 
 void push_ring(struct Ring* ring, double value);
 
+// ring must not be empty, for untracked rings the values are scanned
+void get_extremes_ring(const struct Ring* ring, double* min, double* max);
+
 #endif
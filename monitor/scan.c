@@ -0,0 +1,80 @@
+#include <stdbool.h>
+
+#include "scan.h"
+
+const char* skip_blanks(const char* text) {
+	while (*text == ' ' || *text == '\t' || *text == '\n')
+		text++;
+	return text;
+}
+
+bool scan_u64(const char** text, unsigned long long* value) {
+	const char* c = skip_blanks(*text);
+	if (*c < '0' || *c > '9')
+		return false;
+
+	unsigned long long v = 0;
+	while (*c >= '0' && *c <= '9')
+		v = v * 10 + (*c++ - '0');
+
+	*value = v;
+	*text = c;
+	return true;
+}
+
+bool scan_decimal(const char** text, double* value) {
+	unsigned long long whole;
+	if (!scan_u64(text, &whole))
+		return false;
+
+	double v = whole;
+	const char* c = *text;
+	if (*c == '.') {
+		double scale = 0.1;
+		for (c++; *c >= '0' && *c <= '9'; c++, scale /= 10)
+			v += (*c - '0') * scale;
+	}
+
+	*value = v;
+	*text = c;
+	return true;
+}
+
+bool skip_field(const char** text) {
+	const char* c = skip_blanks(*text);
+	if (!*c)
+		return false;
+	while (*c && *c != ' ' && *c != '\t' && *c != '\n')
+		c++;
+	*text = c;
+	return true;
+}
+
+bool skip_line(const char** text) {
+	const char* c = *text;
+	while (*c && *c != '\n')
+		c++;
+	if (!*c)
+		return false;
+	*text = c + 1;
+	return true;
+}
+
+bool find_line(const char** text, const char* prefix) {
+	for (const char* line = *text; *line;) {
+		const char* c = line;
+		const char* p = prefix;
+		while (*p && *c == *p)
+			c++, p++;
+		if (!*p) {
+			*text = c;
+			return true;
+		}
+
+		while (*line && *line != '\n')
+			line++;
+		if (*line)
+			line++;
+	}
+	return false;
+}
@@ -0,0 +1,22 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+
+// scanners skip leading blanks and move *text past the scanned field,
+// if the field is missing or malformed they return false
+
+bool scan_u64(const char** text, unsigned long long* value);
+
+// decimal number with an optional fraction, as in /proc/uptime
+bool scan_decimal(const char** text, double* value);
+
+bool skip_field(const char** text);
+
+// moves *text to the beginning of the next line
+bool skip_line(const char** text);
+
+// moves *text past the prefix of the first line starting with it
+bool find_line(const char** text, const char* prefix);
+
+#endif
@@ -0,0 +1,253 @@
+#include <err.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "screen.h"
+#include "render.h"
+
+// the template has the labels, the widgets are drawn over it
+static const struct Layout overview[] = {
+	{ WIDGET_PLOT, 0, 0, PLOT_WIDTH, PLOT_HEIGHT, METRIC_CPU, MODE_PLAIN, false },
+	{ WIDGET_PLOT, 0, 12, PLOT_WIDTH, PLOT_HEIGHT, METRIC_CPU_TMP, MODE_FLUCT, false },
+	{ WIDGET_PLOT, 0, 42, PLOT_WIDTH, PLOT_HEIGHT, METRIC_RAM_TMP, MODE_FLUCT, false },
+	{ WIDGET_PLOT, 0, 54, PLOT_WIDTH, PLOT_HEIGHT, METRIC_RAM, MODE_PLAIN, false },
+	{ WIDGET_PLOT, 90, 0, PLOT_WIDTH, PLOT_HEIGHT, METRIC_NET_TX, MODE_NORM, false },
+	{ WIDGET_PLOT, 90, 12, PLOT_WIDTH, PLOT_HEIGHT, METRIC_NET_RX, MODE_NORM, false },
+	{ WIDGET_PLOT, 90, 42, PLOT_WIDTH, PLOT_HEIGHT, METRIC_DISK_R, MODE_NORM, false },
+	{ WIDGET_PLOT, 90, 54, PLOT_WIDTH, PLOT_HEIGHT, METRIC_DISK_W, MODE_NORM, false },
+
+	{ WIDGET_SCALAR, 49, 6, 11, 4, METRIC_CPU, MODE_PERCENT, false },
+	{ WIDGET_SCALAR, 49, 12, 11, 4, METRIC_CPU_TMP, MODE_PLAIN, false },
+	{ WIDGET_SCALAR, 49, 48, 11, 4, METRIC_RAM_TMP, MODE_PLAIN, false },
+	{ WIDGET_SCALAR, 49, 54, 11, 4, METRIC_RAM, MODE_PERCENT, false },
+
+	{ WIDGET_PREFIXED, 53, 0, 33, 4, METRIC_NET_TX, MODE_PLAIN, false },
+	{ WIDGET_PREFIXED, 53, 18, 33, 4, METRIC_NET_RX, MODE_PLAIN, false },
+	{ WIDGET_PREFIXED, 53, 42, 33, 4, METRIC_DISK_R, MODE_PLAIN, false },
+	{ WIDGET_PREFIXED, 53, 60, 33, 4, METRIC_DISK_W, MODE_PLAIN, false },
+
+	{ WIDGET_SCALAR, 94, 25, 11, 4, METRIC_DAYS, MODE_PLAIN, true },
+	{ WIDGET_SCALAR, 98, 30, 7, 4, METRIC_HOURS, MODE_PLAIN, true },
+	{ WIDGET_SCALAR, 98, 35, 7, 4, METRIC_MINUTES, MODE_PLAIN, true },
+
+	{ WIDGET_SCALAR, 18, 25, 15, 4, METRIC_FAN1, MODE_PLAIN, false },
+	{ WIDGET_SCALAR, 18, 30, 15, 4, METRIC_FAN2, MODE_PLAIN, false },
+	{ WIDGET_SCALAR, 18, 35, 15, 4, METRIC_FAN3, MODE_PLAIN, false },
+
+	{ WIDGET_HEATMAP, 0, 22, 128, 3, METRIC_CORE_USAGE, MODE_PLAIN, false },
+	{ WIDGET_HEATMAP, 0, 39, 128, 3, METRIC_CORE_FREQ, MODE_PLAIN, false },
+};
+
+// fewer metrics but bigger, it plots only what the overview plots,
+// so the state file stays the same
+static const struct Layout detail[] = {
+	{ WIDGET_LINE, 0, 0, PLOT_WIDTH, 20, METRIC_CPU, MODE_PLAIN, false },
+	{ WIDGET_ENVELOPE, 45, 0, PLOT_WIDTH, 20, METRIC_CPU_TMP, MODE_FLUCT, false },
+	{ WIDGET_PLOT, 90, 0, PLOT_WIDTH, 20, METRIC_RAM, MODE_PLAIN, false },
+
+	{ WIDGET_HEATMAP, 0, 22, 128, 5, METRIC_CORE_USAGE, MODE_PLAIN, false },
+	{ WIDGET_HEATMAP, 0, 29, 128, 5, METRIC_CORE_FREQ, MODE_PLAIN, false },
+	{ WIDGET_HEATMAP, 0, 36, 128, 4, METRIC_LINK_TRAFFIC, MODE_PLAIN, false },
+
+	{ WIDGET_LINE, 0, 42, PLOT_WIDTH, 22, METRIC_NET_TX, MODE_NORM, false },
+	{ WIDGET_LINE, 45, 42, PLOT_WIDTH, 22, METRIC_NET_RX, MODE_NORM, false },
+	{ WIDGET_ENVELOPE, 90, 42, PLOT_WIDTH, 22, METRIC_RAM_TMP, MODE_FLUCT, false },
+};
+
+static const struct {
+	const struct Layout* layout;
+	size_t count;
+	bool template;
+} views[] = {
+	[VIEW_OVERVIEW] = { overview, sizeof(overview) / sizeof(*overview), true },
+	[VIEW_DETAIL] = { detail, sizeof(detail) / sizeof(*detail), false },
+};
+
+// heatmaps take the array of the cores or of the links
+static const size_t metric_offsets[] = {
+	[METRIC_CPU] = offsetof(struct Stats, cpu),
+	[METRIC_CPU_TMP] = offsetof(struct Stats, cpu_tmp),
+	[METRIC_RAM_TMP] = offsetof(struct Stats, ram_tmp),
+	[METRIC_RAM] = offsetof(struct Stats, ram),
+	[METRIC_NET_RX] = offsetof(struct Stats, net_rx),
+	[METRIC_NET_TX] = offsetof(struct Stats, net_tx),
+	[METRIC_DISK_R] = offsetof(struct Stats, disk_r),
+	[METRIC_DISK_W] = offsetof(struct Stats, disk_w),
+	[METRIC_FAN1] = offsetof(struct Stats, fan1),
+	[METRIC_FAN2] = offsetof(struct Stats, fan2),
+	[METRIC_FAN3] = offsetof(struct Stats, fan3),
+	[METRIC_DAYS] = offsetof(struct Stats, days),
+	[METRIC_HOURS] = offsetof(struct Stats, hours),
+	[METRIC_MINUTES] = offsetof(struct Stats, minutes),
+	[METRIC_CORE_USAGE] = offsetof(struct Stats, core_usage),
+	[METRIC_CORE_FREQ] = offsetof(struct Stats, core_freq),
+	[METRIC_LINK_TRAFFIC] = offsetof(struct Stats, link_traffic),
+};
+
+static bool is_plot(const struct Layout* layout) {
+	return layout->type == WIDGET_PLOT || layout->type == WIDGET_LINE || layout->type == WIDGET_ENVELOPE;
+}
+
+static const double* get_metric(const struct Stats* stats, enum Metric metric) {
+	return (const double*)((const char*)stats + metric_offsets[metric]);
+}
+
+void init_screen(
+		struct Screen* screen,
+		const char* state_path,
+		double sample_rate,
+		enum Resolution resolution,
+		enum Consolidation consolidation
+) {
+	// the histories don't depend on which views are shown
+	bool plotted[METRICS] = {};
+	for (size_t id = 0; id < VIEWS; id++)
+		for (size_t i = 0; i < views[id].count; i++)
+			if (is_plot(views[id].layout + i))
+				plotted[views[id].layout[i].metric] = true;
+
+	size_t histories = 0;
+	for (size_t metric = 0; metric < METRICS; metric++)
+		histories += plotted[metric];
+	init_state(&screen->state, state_path, histories, PLOT_WIDTH, 60 * sample_rate + 0.5);
+
+	for (size_t metric = 0; metric < METRICS; metric++)
+		screen->histories[metric] = plotted[metric] ? take_history(&screen->state) : NULL;
+	for (size_t id = 0; id < VIEWS; id++)
+		screen->views[id] = NULL;
+
+	screen->resolution = resolution;
+	screen->consolidation = consolidation;
+}
+
+struct View* add_view_screen(struct Screen* screen, enum ViewId id, unsigned char* frame) {
+	struct View* view = malloc(sizeof(struct View));
+	if (!view)
+		err(1, "failed to allocate memory for views");
+	screen->views[id] = view;
+
+	if (frame)
+		init_area(&view->area, frame, 128, 64);
+	else
+		alloc_area(&view->area, 128, 64);
+	if (views[id].template)
+		render_template(&view->area);
+
+	reset_damage(view->damage, DISPLAY_PAGES);
+	damage_area(&view->area, view->damage);
+
+	const struct Layout* layout = views[id].layout;
+	view->widget_count = views[id].count;
+	if (!(view->widgets = calloc(view->widget_count, sizeof(struct Widget))))
+		err(1, "failed to allocate memory for widgets");
+
+	for (size_t i = 0; i < view->widget_count; i++) {
+		struct Widget* widget = view->widgets + i;
+		widget->layout = layout + i;
+		subarea(&view->area, &widget->area, layout[i].x, layout[i].y, layout[i].width, layout[i].height);
+
+		if (layout[i].type == WIDGET_HEATMAP)
+			if (!(widget->levels = malloc(layout[i].width * layout[i].height)))
+				err(1, "failed to allocate memory for widgets");
+	}
+
+	return view;
+}
+
+void push_screen(struct Screen* screen, const struct Stats* stats) {
+	begin_update_state(&screen->state);
+	for (size_t metric = 0; metric < METRICS; metric++)
+		if (screen->histories[metric])
+			push_history(screen->histories[metric], *get_metric(stats, metric));
+	end_update_state(&screen->state);
+}
+
+static const struct Ring* plot_ring(const struct Screen* screen, const struct History* history) {
+	return get_history(history, screen->resolution, screen->consolidation);
+}
+
+static const enum PlotScale plot_scales[] = {
+	[MODE_PLAIN] = PLOT_UNIT,
+	[MODE_NORM] = PLOT_NORM,
+	[MODE_FLUCT] = PLOT_FLUCT,
+};
+
+static size_t heatmap_count(const struct Stats* stats, enum Metric metric) {
+	return metric == METRIC_LINK_TRAFFIC ? stats->links : stats->cores;
+}
+
+static void render_widget(
+		struct Screen* screen,
+		struct View* view,
+		struct Widget* widget,
+		const struct Stats* stats
+) {
+	const struct Layout* layout = widget->layout;
+	const double* value = get_metric(stats, layout->metric);
+
+	if (layout->type == WIDGET_HEATMAP) {
+		unsigned char levels[layout->width * layout->height];
+		size_t cells = quantize_heatmap(&widget->area, value, heatmap_count(stats, layout->metric), levels);
+		if (widget->drawn && cells == widget->cells && !memcmp(levels, widget->levels, cells))
+			return;
+		memcpy(widget->levels, levels, cells);
+		widget->cells = cells;
+		render_heatmap_levels(&widget->area, levels, cells);
+	} else if (is_plot(layout)) {
+		// the envelope is of the minimums and maximums of the same tier,
+		// which are pushed together, samples have no spread, so it'd be
+		// a line of a pixel anyway, and it's drawn as a line of them
+		const struct History* history = screen->histories[layout->metric];
+		const struct Ring* ring = plot_ring(screen, history);
+		const struct Ring* upper = NULL;
+		enum PlotStyle style = layout->type == WIDGET_PLOT ? PLOT_BARS : PLOT_LINE;
+		if (layout->type == WIDGET_ENVELOPE && screen->resolution != RESOLUTION_SAMPLE) {
+			ring = get_history(history, screen->resolution, CONSOLIDATION_MIN);
+			upper = get_history(history, screen->resolution, CONSOLIDATION_MAX);
+			style = PLOT_ENVELOPE;
+		}
+
+		// a ring changes only by being pushed to
+		if (widget->drawn && ring->pushed == widget->shown)
+			return;
+		widget->shown = ring->pushed;
+		render_plot_styled(&widget->area, ring, upper, plot_scales[layout->mode], style);
+	} else {
+		unsigned long long shown = *value * (layout->mode == MODE_PERCENT ? 100 : 1);
+		if (widget->drawn && shown == widget->shown)
+			return;
+		widget->shown = shown;
+		if (layout->type == WIDGET_PREFIXED)
+			render_scalar_prefixed(&widget->area, shown);
+		else
+			render_scalar(&widget->area, shown);
+	}
+
+	widget->drawn = true;
+	damage_area(&widget->area, view->damage);
+}
+
+void render_text_screen(struct Screen* screen, const struct Stats* stats) {
+	for (size_t id = 0; id < VIEWS; id++) {
+		struct View* view = screen->views[id];
+		for (size_t i = 0; view && i < view->widget_count; i++)
+			if (view->widgets[i].layout->text)
+				render_widget(screen, view, view->widgets + i, stats);
+	}
+}
+
+void render_screen(struct Screen* screen, const struct Stats* stats) {
+	for (size_t id = 0; id < VIEWS; id++) {
+		struct View* view = screen->views[id];
+		for (size_t i = 0; view && i < view->widget_count; i++)
+			if (!view->widgets[i].layout->text)
+				render_widget(screen, view, view->widgets + i, stats);
+	}
+}
+
+void take_damage_screen(struct Screen* screen, enum ViewId id, struct Damage* damage) {
+	struct View* view = screen->views[id];
+	memcpy(damage, view->damage, sizeof(view->damage));
+	reset_damage(view->damage, DISPLAY_PAGES);
+}
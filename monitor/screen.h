@@ -0,0 +1,146 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdbool.h>
+
+#include "area.h"
+#include "history.h"
+#include "protocol.h"
+#include "state.h"
+#include "stats.h"
+
+#define PLOT_WIDTH 38
+#define PLOT_HEIGHT 10
+
+enum WidgetType {
+	// see render_scalar()
+	WIDGET_SCALAR,
+	// see render_scalar_prefixed()
+	WIDGET_PREFIXED,
+	// the history of the metric as bars, a line or the envelope
+	// of the minimums and maximums, which is a line at the resolution
+	// of samples, see render_plot_styled()
+	WIDGET_PLOT,
+	WIDGET_LINE,
+	WIDGET_ENVELOPE,
+	// a cell per core or per counted interface, see render_heatmap()
+	WIDGET_HEATMAP,
+};
+
+enum Mode {
+	MODE_PLAIN,
+	// scalars of fractions are shown in percent
+	MODE_PERCENT,
+	// plots, see enum PlotScale
+	MODE_NORM,
+	MODE_FLUCT,
+};
+
+// fields of struct Stats, the plotted ones come first in the order
+// their histories are kept in the state file
+enum Metric {
+	METRIC_CPU,
+	METRIC_CPU_TMP,
+	METRIC_RAM_TMP,
+	METRIC_RAM,
+	METRIC_NET_RX,
+	METRIC_NET_TX,
+	METRIC_DISK_R,
+	METRIC_DISK_W,
+	METRIC_FAN1,
+	METRIC_FAN2,
+	METRIC_FAN3,
+	METRIC_DAYS,
+	METRIC_HOURS,
+	METRIC_MINUTES,
+	METRIC_CORE_USAGE,
+	METRIC_CORE_FREQ,
+	METRIC_LINK_TRAFFIC,
+	METRICS,
+};
+
+// the layouts of the screen, an output shows one of them
+enum ViewId {
+	// everything, over the labels of the template
+	VIEW_OVERVIEW,
+	// bigger plots and heatmaps, without labels
+	VIEW_DETAIL,
+	VIEWS,
+};
+
+// a row of the layout table
+struct Layout {
+	enum WidgetType type;
+	size_t x;
+	size_t y;
+	size_t width;
+	size_t height;
+	enum Metric metric;
+	enum Mode mode;
+	// drawn by render_text_screen() instead of render_screen()
+	bool text;
+};
+
+// a widget is drawn only when what it shows changes
+struct Widget {
+	const struct Layout* layout;
+	struct Area area;
+	bool drawn;
+	// the number of scalars or the pushes to the ring of plots
+	unsigned long long shown;
+	// the dithering levels of heatmaps
+	unsigned char* levels;
+	size_t cells;
+};
+
+// a layout with the frame it's rendered into
+struct View {
+	struct Area area;
+	struct Widget* widgets;
+	size_t widget_count;
+
+	// what was drawn since the damage was last taken
+	struct Damage damage[DISPLAY_PAGES];
+};
+
+// the views shown by the outputs and the histories drawn by them
+struct Screen {
+	// NULL for views no output shows
+	struct View* views[VIEWS];
+
+	// NULL for metrics that aren't plotted by any view
+	struct History* histories[METRICS];
+
+	struct State state;
+	// history the plots are drawn from
+	enum Resolution resolution;
+	enum Consolidation consolidation;
+};
+
+// with NULL state_path histories are kept in memory only,
+// the screen starts without views
+void init_screen(
+		struct Screen* screen,
+		const char* state_path,
+		double sample_rate,
+		enum Resolution resolution,
+		enum Consolidation consolidation
+);
+
+// since the program will never stop and free it's resources, there is no free_screen()
+
+// with NULL frame the view allocates its own, a view is added once
+struct View* add_view_screen(struct Screen* screen, enum ViewId id, unsigned char* frame);
+
+// histories are pushed once, whichever views show them
+void push_screen(struct Screen* screen, const struct Stats* stats);
+
+// the uptime text is updated separately from the rest of the views
+void render_text_screen(struct Screen* screen, const struct Stats* stats);
+
+void render_screen(struct Screen* screen, const struct Stats* stats);
+
+// copies the damage of DISPLAY_PAGES pages of the view and starts over
+void take_damage_screen(struct Screen* screen, enum ViewId id, struct Damage* damage);
+
+#endif
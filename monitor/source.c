@@ -0,0 +1,484 @@
+#include <err.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "source.h"
+#include "timing.h"
+
+static const char* sysroot = "";
+
+void set_sysroot(const char* path) {
+	sysroot = path;
+}
+
+void rooted_path(char* rooted, const char* path) {
+	if (snprintf(rooted, PATH_MAX, "%s%s", sysroot, path) >= PATH_MAX)
+		errx(1, "path `%s%s` is too long", sysroot, path);
+}
+
+// the log is a header followed by records in the native byte order,
+// each starts with its type and the index of the file it's about:
+// RECORD_PATH assigns the index to the path given by u16 length and bytes,
+// RECORD_READ has f64 time of the read, u32 length and the data,
+// RECORD_SAME has f64 time of the read, that returned the same data as the last one,
+// RECORD_FAIL has f64 time of the read, that failed,
+// RECORD_EXISTS has u8 result of exists_source()
+
+#define LOG_MAGIC "stupidmonitor-log-1\n"
+
+enum Record {
+	RECORD_PATH = 'p',
+	RECORD_READ = 'r',
+	RECORD_SAME = 's',
+	RECORD_FAIL = 'f',
+	RECORD_EXISTS = 'e',
+};
+
+// files seen in the log so far and their last data
+struct Logged {
+	char* path;
+	char* data;
+	size_t length;
+};
+
+static FILE* log_file;
+static bool replaying;
+static struct Logged* logged;
+static size_t logged_count;
+
+void write_log(const void* data, size_t size) {
+	if (size && fwrite(data, size, 1, log_file) != 1)
+		err(1, "failed to write to the log");
+}
+
+void read_log(void* data, size_t size) {
+	if (!size || fread(data, size, 1, log_file) == 1)
+		return;
+	if (ferror(log_file))
+		err(1, "failed to read the log");
+	warnx("replay finished");
+	exit(0);
+}
+
+// the index of the path, new paths are written to the log while recording
+uint16_t find_logged(const char* path) {
+	for (size_t i = 0; i < logged_count; i++)
+		if (!strcmp(logged[i].path, path))
+			return i;
+	if (replaying || logged_count == UINT16_MAX)
+		errx(1, "file `%s` isn't in the log", path);
+
+	if (!(logged = realloc(logged, (logged_count + 1) * sizeof(*logged))))
+		err(1, "failed to allocate memory for the log");
+	if (!(logged[logged_count].path = strdup(path)))
+		err(1, "failed to allocate memory for the log");
+	logged[logged_count].data = NULL;
+	logged[logged_count].length = SIZE_MAX;
+
+	uint16_t index = logged_count++;
+	uint16_t length = strlen(path);
+	write_log((unsigned char[]) { RECORD_PATH }, 1);
+	write_log(&index, sizeof(index));
+	write_log(&length, sizeof(length));
+	write_log(path, length);
+	return index;
+}
+
+// the next record that isn't a path, which are registered on the way
+unsigned char next_log(uint16_t* index) {
+	for (;;) {
+		unsigned char type;
+		read_log(&type, 1);
+		read_log(index, sizeof(*index));
+		if (type != RECORD_PATH) {
+			if (*index >= logged_count)
+				errx(1, "the log refers to an unknown file");
+			return type;
+		}
+
+		uint16_t length;
+		read_log(&length, sizeof(length));
+		if (*index != logged_count)
+			errx(1, "the log is corrupted");
+		if (!(logged = realloc(logged, (logged_count + 1) * sizeof(*logged))))
+			err(1, "failed to allocate memory for the log");
+		if (!(logged[logged_count].path = malloc(length + 1)))
+			err(1, "failed to allocate memory for the log");
+		read_log(logged[logged_count].path, length);
+		logged[logged_count].path[length] = '\0';
+		logged[logged_count].data = NULL;
+		logged[logged_count].length = 0;
+		logged_count++;
+	}
+}
+
+void record_sources(const char* path) {
+	if (!(log_file = fopen(path, "w")))
+		err(1, "failed to open `%s`", path);
+	write_log(LOG_MAGIC, sizeof(LOG_MAGIC) - 1);
+}
+
+void replay_sources(const char* path) {
+	if (!(log_file = fopen(path, "r")))
+		err(1, "failed to open `%s`", path);
+
+	char magic[sizeof(LOG_MAGIC) - 1];
+	if (fread(magic, sizeof(magic), 1, log_file) != 1 || memcmp(magic, LOG_MAGIC, sizeof(magic)))
+		errx(1, "`%s` isn't a log", path);
+
+	replaying = true;
+	use_virtual_clock();
+}
+
+void record_read(const struct Source* source) {
+	uint16_t index = find_logged(source->path);
+	struct Logged* file = logged + index;
+	bool same = file->length == source->length && !memcmp(file->data, source->buff, source->length);
+	unsigned char type = source->failed ? RECORD_FAIL : same ? RECORD_SAME : RECORD_READ;
+
+	write_log(&type, 1);
+	write_log(&index, sizeof(index));
+	write_log(&source->time, sizeof(source->time));
+	if (type != RECORD_READ)
+		return;
+
+	uint32_t length = source->length;
+	write_log(&length, sizeof(length));
+	write_log(source->buff, length);
+
+	if (!(file->data = realloc(file->data, source->length + 1)))
+		err(1, "failed to allocate memory for the log");
+	memcpy(file->data, source->buff, source->length);
+	file->length = source->length;
+}
+
+void replay_read(struct Source* source) {
+	uint16_t index;
+	unsigned char type = next_log(&index);
+	struct Logged* file = logged + index;
+	if (type == RECORD_EXISTS || strcmp(file->path, source->path))
+		errx(1, "replay of `%s` diverged from the log at `%s`", source->path, file->path);
+
+	read_log(&source->time, sizeof(source->time));
+	source->failed = type == RECORD_FAIL;
+	if (source->failed) {
+		source->length = 0;
+		source->buff[0] = '\0';
+		return;
+	}
+	if (type == RECORD_READ) {
+		uint32_t length;
+		read_log(&length, sizeof(length));
+		if (!(file->data = realloc(file->data, length + 1)))
+			err(1, "failed to allocate memory for the log");
+		read_log(file->data, length);
+		file->length = length;
+	}
+
+	// the buffer may be smaller than the one it was recorded with
+	source->length = file->length < source->size - 1 ? file->length : source->size - 1;
+	memcpy(source->buff, file->data, source->length);
+	source->buff[source->length] = '\0';
+}
+
+bool exists_source(const char* path) {
+	unsigned char exists;
+	if (replaying) {
+		uint16_t index;
+		if (next_log(&index) != RECORD_EXISTS || strcmp(logged[index].path, path))
+			errx(1, "replay of `%s` diverged from the log at `%s`", path, logged[index].path);
+		read_log(&exists, sizeof(exists));
+		return exists;
+	}
+
+	char rooted[PATH_MAX];
+	rooted_path(rooted, path);
+	exists = !access(rooted, R_OK);
+
+	if (log_file) {
+		uint16_t index = find_logged(path);
+		write_log((unsigned char[]) { RECORD_EXISTS }, 1);
+		write_log(&index, sizeof(index));
+		write_log(&exists, sizeof(exists));
+	}
+	return exists;
+}
+
+void open_source(struct Source* source) {
+	if (source->fd != -1 || replaying)
+		return;
+
+	char rooted[PATH_MAX];
+	rooted_path(rooted, source->path);
+	source->fd = open(rooted, O_RDONLY | O_CLOEXEC);
+	if (source->fd == -1 && !source->fallible)
+		err(1, "failed to open `%s`", rooted);
+}
+
+void finish_source(struct Source* source, ssize_t r) {
+	source->failed = r < 0 && source->fallible;
+	if (source->failed) {
+		r = 0;
+	} else if (r < 0) {
+		errno = -r;
+		err(1, "failed to read `%s`", source->path);
+	}
+	source->length = r;
+	source->buff[r] = '\0';
+	source->time = get_time();
+
+	if (log_file)
+		record_read(source);
+}
+
+void read_source(struct Source* source) {
+	if (replaying) {
+		replay_read(source);
+		return;
+	}
+
+	// errno is of the open if it failed
+	open_source(source);
+	ssize_t r = source->fd != -1 ? pread(source->fd, source->buff, source->size - 1, 0) : -1;
+	finish_source(source, r == -1 ? -errno : r);
+}
+
+void list_source(struct Source* source) {
+	if (replaying) {
+		replay_read(source);
+		return;
+	}
+
+	char rooted[PATH_MAX];
+	rooted_path(rooted, source->path);
+	DIR* dir = opendir(rooted);
+	if (!dir && source->fallible) {
+		finish_source(source, -errno);
+		return;
+	}
+	if (!dir)
+		err(1, "failed to open `%s`", rooted);
+
+	size_t length = 0;
+	for (struct dirent* entry; (entry = readdir(dir));) {
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+		size_t name_length = strlen(entry->d_name);
+		if (length + name_length + 1 > source->size - 1)
+			errx(1, "too many files in `%s`", rooted);
+		memcpy(source->buff + length, entry->d_name, name_length);
+		source->buff[length + name_length] = '\n';
+		length += name_length + 1;
+	}
+	closedir(dir);
+
+	finish_source(source, length);
+}
+
+void fetch_source(struct Source* source, ssize_t (*fetch)(char* buff, size_t size, void* arg), void* arg) {
+	if (replaying) {
+		replay_read(source);
+		return;
+	}
+
+	finish_source(source, fetch(source->buff, source->size - 1, arg));
+}
+
+// glibc has no wrappers and liburing isn't worth a dependency for one batch
+
+struct Uring {
+	int fd;
+	unsigned entries;
+	unsigned* sq_tail;
+	unsigned* sq_mask;
+	unsigned* sq_array;
+	struct io_uring_sqe* sqes;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_mask;
+	struct io_uring_cqe* cqes;
+};
+
+// returns NULL if io_uring is unavailable
+struct Uring* init_uring(struct Source** sources, size_t count) {
+	struct io_uring_params params = {};
+	int fd = syscall(__NR_io_uring_setup, count, &params);
+	if (fd == -1)
+		return NULL;
+
+	// IORING_OP_READ appeared later than io_uring itself
+	struct {
+		struct io_uring_probe probe;
+		struct io_uring_probe_op ops[IORING_OP_READ + 1];
+	} probe = {};
+	if (
+		syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, &probe, IORING_OP_READ + 1) ||
+		probe.probe.last_op < IORING_OP_READ ||
+		!(probe.ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+	) {
+		close(fd);
+		return NULL;
+	}
+
+	int fds[count];
+	for (size_t i = 0; i < count; i++)
+		fds[i] = sources[i]->fd;
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES, fds, count)) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single_mmap && cq_size > sq_size)
+		sq_size = cq_size;
+
+	char* sq = mmap(
+		NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		fd, IORING_OFF_SQ_RING
+	);
+	if (sq == MAP_FAILED)
+		err(1, "failed to map io_uring submission queue");
+
+	char* cq = sq;
+	if (!single_mmap) {
+		cq = mmap(
+			NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			fd, IORING_OFF_CQ_RING
+		);
+		if (cq == MAP_FAILED)
+			err(1, "failed to map io_uring completion queue");
+	}
+
+	struct io_uring_sqe* sqes = mmap(
+		NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		fd, IORING_OFF_SQES
+	);
+	if (sqes == MAP_FAILED)
+		err(1, "failed to map io_uring submission entries");
+
+	struct Uring* uring = malloc(sizeof(struct Uring));
+	if (!uring)
+		err(1, "failed to allocate memory for io_uring");
+
+	*uring = (struct Uring) {
+		.fd = fd,
+		.entries = params.sq_entries,
+		.sq_tail = (unsigned*)(sq + params.sq_off.tail),
+		.sq_mask = (unsigned*)(sq + params.sq_off.ring_mask),
+		.sq_array = (unsigned*)(sq + params.sq_off.array),
+		.sqes = sqes,
+		.cq_head = (unsigned*)(cq + params.cq_off.head),
+		.cq_tail = (unsigned*)(cq + params.cq_off.tail),
+		.cq_mask = (unsigned*)(cq + params.cq_off.ring_mask),
+		.cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes),
+	};
+	return uring;
+}
+
+void init_batch(struct Batch* batch, struct Source** sources, size_t count, bool use_uring) {
+	for (size_t i = 0; i < count; i++)
+		open_source(sources[i]);
+
+	batch->sources = sources;
+	batch->count = count;
+	batch->uring = use_uring && !replaying ? init_uring(sources, count) : NULL;
+}
+
+void update_batch(struct Batch* batch, struct Source** sources, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		open_source(sources[i]);
+	batch->sources = sources;
+	batch->count = count;
+
+	struct Uring* uring = batch->uring;
+	if (!uring)
+		return;
+
+	int fds[count];
+	for (size_t i = 0; i < count; i++)
+		fds[i] = sources[i]->fd;
+	if (
+		count > uring->entries ||
+		syscall(__NR_io_uring_register, uring->fd, IORING_UNREGISTER_FILES, NULL, 0) ||
+		syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_FILES, fds, count)
+	) {
+		// the ring stays mapped, it's a rare path
+		close(uring->fd);
+		batch->uring = NULL;
+	}
+}
+
+// every source is read with a registered fd, all of them with a single syscall
+void read_uring(struct Batch* batch) {
+	struct Uring* uring = batch->uring;
+
+	unsigned tail = *uring->sq_tail;
+	for (size_t i = 0; i < batch->count; i++, tail++) {
+		struct Source* source = batch->sources[i];
+		unsigned index = tail & *uring->sq_mask;
+		uring->sqes[index] = (struct io_uring_sqe) {
+			.opcode = IORING_OP_READ,
+			.flags = IOSQE_FIXED_FILE,
+			.fd = i,
+			.addr = (unsigned long)source->buff,
+			.len = source->size - 1,
+			.off = 0,
+			.user_data = i,
+		};
+		uring->sq_array[index] = index;
+	}
+	__atomic_store_n(uring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	// completions come in any order, the sources are finished in the order
+	// they were submitted, which is the order a replay reads them in,
+	// a signal may end the wait before all of them are reaped
+	int results[batch->count];
+	size_t reaped = 0;
+	unsigned submit = batch->count;
+	while (reaped < batch->count) {
+		long r = syscall(
+			__NR_io_uring_enter, uring->fd, submit, batch->count - reaped,
+			IORING_ENTER_GETEVENTS, NULL, 0
+		);
+		if (r == -1 && errno != EINTR)
+			err(1, "failed to enter io_uring");
+		if (r > 0)
+			submit -= r;
+
+		unsigned head = *uring->cq_head;
+		unsigned cq_tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != cq_tail; head++, reaped++) {
+			struct io_uring_cqe* cqe = uring->cqes + (head & *uring->cq_mask);
+			results[cqe->user_data] = cqe->res;
+		}
+		__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	for (size_t i = 0; i < batch->count; i++)
+		finish_source(batch->sources[i], results[i]);
+}
+
+void read_batch(struct Batch* batch) {
+	if (batch->uring)
+		read_uring(batch);
+	else
+		for (size_t i = 0; i < batch->count; i++)
+			read_source(batch->sources[i]);
+
+	// a killed recording loses at most the sample being read
+	if (log_file && !replaying && fflush(log_file))
+		err(1, "failed to write to the log");
+}
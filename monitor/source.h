@@ -0,0 +1,78 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+// a file that is kept open and reread from the beginning on every sample
+// into a buffer owned by the caller, the data is null terminated
+struct Source {
+	const char* path;
+	int fd;
+	char* buff;
+	size_t size;
+	size_t length;
+	// when the data was read, rates are calculated from it
+	double time;
+	// a failed read leaves the data empty and sets failed instead of
+	// ending the program, for files that may disappear
+	bool fallible;
+	bool failed;
+};
+
+#define SOURCE(file, buffer) { \
+	.path = (file), .fd = -1, .buff = (buffer), .size = sizeof(buffer) \
+}
+
+// the path is taken relative to the sysroot, a fallible source that can't
+// be opened is left closed, so its reads fail and it's opened again by the next one
+void open_source(struct Source* source);
+
+// opens the source if needed and reads it with a single pread
+void read_source(struct Source* source);
+
+// since the program will never stop and free it's resources, there is no close_source()
+
+// reads the names in the directory at the path separated by newlines,
+// a fallible source reads as empty if the directory is missing,
+// it's recorded and replayed like any other read
+void list_source(struct Source* source);
+
+// the data comes from fetch instead of the file at the path, which only names it
+// in the log, fetch fills at most size bytes and returns their length or -errno,
+// it's recorded and replayed like any other read, the data may be binary
+void fetch_source(struct Source* source, ssize_t (*fetch)(char* buff, size_t size, void* arg), void* arg);
+
+// sources read together once per sample, with io_uring if it's available
+struct Batch {
+	struct Source** sources;
+	size_t count;
+	struct Uring* uring;
+};
+
+// opens all the sources, with use_uring set to false or if io_uring
+// can't be set up, the sources are read one by one
+void init_batch(struct Batch* batch, struct Source** sources, size_t count, bool use_uring);
+
+void read_batch(struct Batch* batch);
+
+// replaces the sources of the batch after some of them were reopened,
+// falls back to reading them one by one if io_uring can't take them
+void update_batch(struct Batch* batch, struct Source** sources, size_t count);
+
+// sources are opened under it instead of /, "" by default
+void set_sysroot(const char* path);
+
+// whether the file exists under the sysroot, the answer is recorded and replayed
+bool exists_source(const char* path);
+
+// every read from now on is appended to a log at path, see source.c
+void record_sources(const char* path);
+
+// reads are served from the log at path instead of the files, in the order
+// they were recorded, with the times they were recorded at, the clock
+// becomes virtual, see use_virtual_clock(), the program exits when the log ends
+void replay_sources(const char* path);
+
+#endif
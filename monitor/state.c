@@ -0,0 +1,176 @@
+#include <err.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "state.h"
+
+#define STATE_MAGIC "stupidmonitor"
+#define STATE_VERSION 2
+
+struct StateHeader {
+	char magic[sizeof(STATE_MAGIC)];
+	uint32_t version;
+	// the pointers in the file are stale, the histories are at the offsets
+	// the arena hands out and are pointed to them wherever the file is mapped
+	uint64_t size;
+	// anything that changes the layout of the histories
+	uint64_t histories;
+	uint64_t capacity;
+	uint64_t samples_per_minute;
+	uint64_t history_size;
+	// odd while the histories are being updated
+	uint64_t sequence;
+};
+
+void fill_header(struct StateHeader* header, size_t size, size_t histories, const struct State* state) {
+	*header = (struct StateHeader) {
+		.magic = STATE_MAGIC,
+		.version = STATE_VERSION,
+		.size = size,
+		.histories = histories,
+		.capacity = state->capacity,
+		.samples_per_minute = state->samples_per_minute,
+		.history_size = sizeof(struct History),
+		.sequence = 0,
+	};
+}
+
+// points the histories in the mapping to their rings, false if any of them
+// doesn't fit the layout of the header, e.g. the file is corrupt
+bool rebind_histories(char* mapping, const struct StateHeader* header) {
+	size_t header_size = ARENA_SIZE(1, sizeof(struct StateHeader));
+	struct Arena arena = { .buff = mapping + header_size, .size = header->size - header_size, .used = 0 };
+	for (size_t i = 0; i < header->histories; i++) {
+		struct History* history = take_arena(&arena, 1, sizeof(struct History));
+		if (!rebind_history_in(history, header->capacity, header->samples_per_minute, &arena))
+			return false;
+	}
+	return true;
+}
+
+// maps the file anywhere, if it's intact
+void* restore_state(int fd, const char* path, size_t size, const struct StateHeader* expected) {
+	struct StateHeader header;
+	ssize_t r = pread(fd, &header, sizeof(header), 0);
+	if (r == -1)
+		err(1, "failed to read `%s`", path);
+	if (r != sizeof(header))
+		return NULL;
+
+	if (
+		memcmp(header.magic, expected->magic, sizeof(header.magic)) ||
+		header.version != expected->version ||
+		header.size != size ||
+		header.histories != expected->histories ||
+		header.capacity != expected->capacity ||
+		header.samples_per_minute != expected->samples_per_minute ||
+		header.history_size != expected->history_size
+	) {
+		warnx("discarding `%s` of a different layout", path);
+		return NULL;
+	}
+
+	if (header.sequence % 2) {
+		warnx("discarding `%s` torn in the middle of an update", path);
+		return NULL;
+	}
+
+	void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED)
+		err(1, "failed to map `%s`", path);
+	if (!rebind_histories(mapping, expected)) {
+		munmap(mapping, size);
+		warnx("discarding `%s` of corrupt histories", path);
+		return NULL;
+	}
+	return mapping;
+}
+
+void init_state(
+		struct State* state,
+		const char* path,
+		size_t histories,
+		size_t capacity,
+		size_t samples_per_minute
+) {
+	state->capacity = capacity;
+	state->samples_per_minute = samples_per_minute;
+	state->restored = false;
+
+	size_t header_size = ARENA_SIZE(1, sizeof(struct StateHeader));
+	size_t size = header_size + histories * (
+		ARENA_SIZE(1, sizeof(struct History)) + HISTORY_SIZE(capacity)
+	);
+
+	struct StateHeader expected;
+	fill_header(&expected, size, histories, state);
+
+	char* mapping = NULL;
+	if (!path) {
+		mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapping == MAP_FAILED)
+			err(1, "failed to map memory for histories");
+	} else {
+		int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd == -1)
+			err(1, "failed to open `%s`", path);
+
+		mapping = restore_state(fd, path, size, &expected);
+		state->restored = mapping;
+
+		if (!mapping) {
+			// truncating first zeroes the whole file
+			if (ftruncate(fd, 0) || ftruncate(fd, size))
+				err(1, "failed to truncate `%s`", path);
+			mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (mapping == MAP_FAILED)
+				err(1, "failed to map `%s`", path);
+		}
+
+		if (close(fd))
+			err(1, "failed to close `%s`", path);
+	}
+
+	state->header = (struct StateHeader*)mapping;
+	if (!state->restored) {
+		// the header is valid, but the sequence is odd until the histories are set up
+		fill_header(state->header, size, histories, state);
+		state->header->sequence = 1;
+	}
+
+	state->arena = (struct Arena) {
+		.buff = mapping + header_size,
+		.size = size - header_size,
+		.used = 0,
+	};
+}
+
+struct History* take_history(struct State* state) {
+	// the arena only finds the addresses when restoring, allocations would zero
+	// the memory, the histories were already rebound by restore_state()
+	if (state->restored) {
+		struct History* history = take_arena(&state->arena, 1, sizeof(struct History));
+		take_arena(&state->arena, 1, HISTORY_SIZE(state->capacity));
+		return history;
+	}
+
+	struct History* history = alloc_arena(&state->arena, 1, sizeof(struct History));
+	size_t used = state->arena.used;
+	alloc_history_in(history, state->capacity, state->samples_per_minute, &state->arena);
+	if (state->arena.used - used != HISTORY_SIZE(state->capacity))
+		errx(1, "HISTORY_SIZE doesn't match alloc_history_in");
+	return history;
+}
+
+void begin_update_state(struct State* state) {
+	// a fresh file is odd until the end of the first update
+	__atomic_store_n(&state->header->sequence, state->header->sequence | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void end_update_state(struct State* state) {
+	__atomic_store_n(&state->header->sequence, state->header->sequence + 1, __ATOMIC_RELEASE);
+}
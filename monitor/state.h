@@ -0,0 +1,43 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "history.h"
+
+// histories living in a memory-mapped file, so a restarted process
+// continues where the previous one stopped, every sample is written
+// straight into the mapping and nothing is saved on exit
+struct State {
+	struct StateHeader* header;
+	struct Arena arena;
+	size_t capacity;
+	size_t samples_per_minute;
+	// the file was valid and the histories are already there
+	bool restored;
+};
+
+// with NULL path the histories live in anonymous memory and aren't kept,
+// a file of a different layout, version or torn by a crash is discarded
+void init_state(
+		struct State* state,
+		const char* path,
+		size_t histories,
+		size_t capacity,
+		size_t samples_per_minute
+);
+
+// since the program will never stop and free it's resources, there is no free_state()
+
+// histories must be taken in the same order on every run
+struct History* take_history(struct State* state);
+
+// pushes to histories must happen between these,
+// a file left in the middle of an update is considered torn
+void begin_update_state(struct State* state);
+
+void end_update_state(struct State* state);
+
+#endif
@@ -1,228 +1,410 @@
-#include <stdio.h>
 #include <err.h>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 
-#include "timing.h"
+#include "stats.h"
+#include "source.h"
+#include "hwmon.h"
+#include "links.h"
+#include "scan.h"
 
-// hwmon names aren't persistent
 // most of this should probably be reimplemented with libsensors
 
-void open_or_die(const char* path, FILE** file) {
-	if (!*file) {
-		 *file = fopen(path, "r");
-		if (!*file)
-			err(1, "failed to open `%s`", path);
-	}
-	else {
-		if (fflush(*file) == EOF)
-			err(1, "failed to flush `%s`", path);
-		rewind(*file);
-	}
+bool scan_cpu_times(const char** text, unsigned long long* busy, unsigned long long* total) {
+	// linux/fs/proc/stat.c uses u64, so long long must be enough
+	// user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice
+	unsigned long long times[10];
+	for (size_t i = 0; i < 10; i++)
+		if (!scan_u64(text, times + i))
+			return false;
+
+	*busy = times[0] + times[1] + times[2] + times[5] + times[6] + times[7] + times[8] + times[9];
+	*total = *busy + times[3] + times[4];
+	return true;
 }
 
-double get_cpu() {
-	const char* path = "/proc/stat";
-	static FILE* stat;
-	open_or_die(path, &stat);
+bool parse_cpu(const char* text, unsigned long long* busy, unsigned long long* total) {
+	return find_line(&text, "cpu ") && scan_cpu_times(&text, busy, total);
+}
 
-	// linux/fs/proc/stat.c uses u64, so long long must be enough
-	unsigned long long user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice;
-	if (fscanf(
-		stat, "cpu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu", 
-		&user, &nice, &system, &idle, &iowait,
-		&irq, &softirq, &steal, &guest, &guest_nice
-	) != 10)
-		errx(1, "failed to parse `%s`", path);
+bool parse_cores(
+		const char* text,
+		const unsigned* ids,
+		unsigned long long* busy,
+		unsigned long long* total,
+		size_t count
+) {
+	// the sum of all cores goes first, the cores follow it
+	if (!find_line(&text, "cpu ") || !skip_line(&text))
+		return false;
+
+	// both the lines and the ids are ascending
+	size_t i = 0;
+	while (text[0] == 'c' && text[1] == 'p' && text[2] == 'u') {
+		text += 3;
+		unsigned long long core, core_busy, core_total;
+		if (!scan_u64(&text, &core) || !scan_cpu_times(&text, &core_busy, &core_total))
+			return false;
+
+		while (i < count && ids[i] < core)
+			i++;
+		if (i < count && ids[i] == core) {
+			busy[i] = core_busy;
+			total[i] = core_total;
+		}
+		if (!skip_line(&text))
+			break;
+	}
+	return true;
+}
 
-	static unsigned long long old_busy, old_total;
-	unsigned long long  busy, total, delta_busy, delta_total;
+bool parse_meminfo(const char* text, unsigned long long* total, unsigned long long* available) {
+	// linux/fs/proc/meminfo.c uses long, but just to be sure
+	return
+		find_line(&text, "MemTotal:") && scan_u64(&text, total) &&
+		find_line(&text, "MemAvailable:") && scan_u64(&text, available);
+}
 
-	busy = user + nice + system + irq + softirq + steal + guest + guest_nice;
-	total = busy + idle + iowait;
+bool parse_disk(const char* text, unsigned long long* read, unsigned long long* written) {
+	// see Documentation/block/stat.rst
+	return
+		skip_field(&text) && skip_field(&text) && scan_u64(&text, read) &&
+		skip_field(&text) && skip_field(&text) && skip_field(&text) &&
+		scan_u64(&text, written);
+}
 
-	delta_busy = busy - old_busy;
-	delta_total = total - old_total;
+// every source has its own buffer and all of them are read at once
+static char meminfo_buff[256];
+static char uptime_buff[64];
+static char sda_buff[256];
+static char sdb_buff[256];
+
+// the buffer is allocated for the lines of all cores
+static struct Source stat = { .path = "/proc/stat", .fd = -1 };
+static struct Source meminfo = SOURCE("/proc/meminfo", meminfo_buff);
+static struct Source uptime = SOURCE("/proc/uptime", uptime_buff);
+static struct Source disks[] = {
+	SOURCE("/sys/block/sda/stat", sda_buff),
+	SOURCE("/sys/block/sdb/stat", sdb_buff),
+};
 
-	old_busy = busy;
-	old_total = total;
+static struct Source* fixed_sources[] = {
+	&stat, &meminfo,
+	&uptime,
+	disks, disks + 1,
+};
 
-	return (double) delta_busy / delta_total;
+// hwmon numbers aren't persistent, so the sensors are found by name
+enum {
+	SENSOR_TCCD1,
+	SENSOR_JC42,
+	SENSOR_FAN1,
+	SENSOR_FAN2,
+	SENSOR_FAN3,
+};
+static struct Sensor sensors[] = {
+	[SENSOR_TCCD1] = { .device = "k10temp", .label = "Tccd1" },
+	[SENSOR_JC42] = { .device = "jc42", .input = "temp1_input" },
+	[SENSOR_FAN1] = { .device = "nct67", .input = "fan1_input" },
+	[SENSOR_FAN2] = { .device = "nct67", .input = "fan2_input" },
+	[SENSOR_FAN3] = { .device = "nct67", .input = "fan3_input" },
+};
+#define SENSORS (sizeof(sensors) / sizeof(*sensors))
+
+static size_t core_count;
+static unsigned core_ids[MAX_CORES];
+// scaling_cur_freq of every core, NULL without cpufreq,
+// they fail while their core is offline
+static struct Source* core_freqs;
+static char core_freq_buffs[MAX_CORES][32];
+static double core_max_freqs[MAX_CORES];
+
+static struct Batch batch;
+// every network interface, the totals are shown
+static struct Links links;
+// the fixed sources, the sensors that were found and the cpufreq ones
+static struct Source** sources;
+
+size_t parse_core_list(const char* text, unsigned* ids, size_t max) {
+	size_t count = 0;
+	do {
+		unsigned long long first, last;
+		if (!scan_u64(&text, &first))
+			return 0;
+		last = first;
+		if (*text == '-') {
+			text++;
+			if (!scan_u64(&text, &last) || last < first)
+				return 0;
+		}
+		if (count && first <= ids[count - 1])
+			return 0;
+		for (unsigned long long id = first; id <= last && count < max; id++)
+			ids[count++] = id;
+	} while (*text++ == ',');
+	return count;
 }
 
-double get_ram() {
-	const char* path = "/proc/meminfo";
-	static FILE* meminfo;
-	open_or_die(path, &meminfo);
-
-	// linux/fs/proc/meminfo.c uses long, but just to be sure
-	unsigned long long total, available;
-
-	if (fscanf(
-		meminfo, 
-		"MemTotal: %llu kB MemFree: %*u kB MemAvailable: %llu kB", 
-		&total, &available
-	) != 2)
-		errx(1, "failed to parse `%s`", path);
+// the cores are listed once, so hotplugged cores that weren't present are ignored,
+// the file is read like the others to be recorded and replayed
+size_t list_cores(unsigned* ids, size_t max) {
+	char present_buff[256];
+	struct Source present = SOURCE("/sys/devices/system/cpu/present", present_buff);
+	read_source(&present);
+	close(present.fd);
+
+	size_t count = parse_core_list(present_buff, ids, max);
+	if (!count)
+		errx(1, "failed to parse `%s`", present.path);
+	return count;
+}
 
-	return (double) (total - available) / total;
+// the frequency of a core without the maximum, e.g. offline since the start, is 0
+void read_max_freq(size_t core) {
+	char path[128], max_buff[32];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq", core_ids[core]);
+	struct Source max_freq = SOURCE(path, max_buff);
+	max_freq.fallible = true;
+	read_source(&max_freq);
+	if (max_freq.fd != -1)
+		close(max_freq.fd);
+
+	const char* text = max_buff;
+	unsigned long long value;
+	core_max_freqs[core] = scan_u64(&text, &value) ? value : 0;
 }
 
-double get_tccd1() {
-	const char* path = "/sys/class/hwmon/hwmon0/temp3_input";
-	static FILE* temp3_input;
-	open_or_die(path, &temp3_input);
+size_t collect_sources() {
+	size_t count = 0;
+	for (size_t i = 0; i < sizeof(fixed_sources) / sizeof(*fixed_sources); i++)
+		sources[count++] = fixed_sources[i];
+	for (size_t i = 0; i < SENSORS; i++)
+		if (sensors[i].source.path)
+			sources[count++] = &sensors[i].source;
+	if (core_freqs)
+		for (size_t i = 0; i < core_count; i++)
+			sources[count++] = core_freqs + i;
+	return count;
+}
 
-	unsigned long temp;
-	if (fscanf(temp3_input, "%lu", &temp) != 1)
-		errx(1, "failed to parse `%s`", path);
+void init_stats() {
+	core_count = list_cores(core_ids, MAX_CORES);
+
+	// a line of ten u64 fields must fit in 256 bytes
+	stat.size = 256 * (core_count + 1);
+	if (!(stat.buff = malloc(stat.size)))
+		err(1, "failed to allocate buffer for `%s`", stat.path);
+
+	size_t fixed_count = sizeof(fixed_sources) / sizeof(*fixed_sources);
+	sources = malloc((fixed_count + SENSORS + core_count) * sizeof(struct Source*));
+	if (!sources)
+		err(1, "failed to allocate memory for sources");
+
+	init_sensors(sensors, SENSORS);
+	init_links(&links);
+
+	char path[128];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cpufreq/scaling_cur_freq", core_ids[0]);
+	if (exists_source(path)) {
+		if (!(core_freqs = calloc(core_count, sizeof(struct Source))))
+			err(1, "failed to allocate memory for cpufreq sources");
+
+		for (size_t i = 0; i < core_count; i++) {
+			read_max_freq(i);
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cpufreq/scaling_cur_freq", core_ids[i]);
+			if (!(core_freqs[i].path = strdup(path)))
+				err(1, "failed to allocate memory for cpufreq sources");
+			core_freqs[i].fd = -1;
+			core_freqs[i].buff = core_freq_buffs[i];
+			core_freqs[i].size = sizeof(core_freq_buffs[i]);
+			core_freqs[i].fallible = true;
+		}
+	}
 
-	return temp / 1000.0;
+	init_batch(&batch, sources, collect_sources(), true);
 }
 
-double get_jc42() {
-	const char* path = "/sys/class/hwmon/hwmon1/temp1_input";
-	static FILE* temp1_input;
-	open_or_die(path, &temp1_input);
-
-	unsigned long temp;
-	if (fscanf(temp1_input, "%lu", &temp) != 1)
-		errx(1, "failed to parse `%s`", path);
+// a sensor that keeps failing while its device stays doesn't relist them every sample
+#define RESCAN_PERIOD 5
+
+// a failed read means the device of the sensor went away, possibly
+// to come back under another number, the devices are listed at most
+// every RESCAN_PERIOD seconds and the sensors are only found again
+// if the devices changed, their fresh values are read right away
+void check_sensors() {
+	static double checked = -INFINITY;
+	double failed = NAN;
+	for (size_t i = 0; i < SENSORS; i++)
+		if (sensors[i].source.path && sensors[i].source.failed)
+			failed = sensors[i].source.time;
+	if (isnan(failed) || failed - checked < RESCAN_PERIOD)
+		return;
+	checked = failed;
+
+	if (!rescan_sensors(sensors, SENSORS))
+		return;
+	update_batch(&batch, sources, collect_sources());
+	for (size_t i = 0; i < SENSORS; i++)
+		if (sensors[i].source.path)
+			read_source(&sensors[i].source);
+}
 
-	return temp / 1000.0;
+// an offline core fails its cpufreq reads, its file may be gone or stale by the time
+// it's back, so the failed ones are reopened and the missing maximums are read again
+// once their core is back, at most every RESCAN_PERIOD seconds
+void check_cores() {
+	static double checked = -INFINITY;
+	double missing = NAN;
+	for (size_t i = 0; core_freqs && i < core_count; i++)
+		if (core_freqs[i].failed || !core_max_freqs[i])
+			missing = core_freqs[i].time;
+	if (isnan(missing) || missing - checked < RESCAN_PERIOD)
+		return;
+	checked = missing;
+
+	bool reopen = false;
+	for (size_t i = 0; i < core_count; i++)
+		if (core_freqs[i].failed) {
+			if (core_freqs[i].fd != -1)
+				close(core_freqs[i].fd);
+			core_freqs[i].fd = -1;
+			reopen = true;
+		} else if (!core_max_freqs[i]) {
+			read_max_freq(i);
+		}
+	if (reopen)
+		update_batch(&batch, sources, collect_sources());
 }
 
-double get_fan1() {
-	const char* path = "/sys/class/hwmon/hwmon2/fan1_input";
-	static FILE* fan1_input;
-	open_or_die(path, &fan1_input);
+unsigned long long parse_u64(const struct Source* source) {
+	const char* text = source->buff;
+	unsigned long long value;
+	if (!scan_u64(&text, &value))
+		errx(1, "failed to parse `%s`", source->path);
+	return value;
+}
 
-	unsigned int speed;
-	if (fscanf(fan1_input, "%u", &speed) != 1)
-		errx(1, "failed to parse `%s`", path);
+double get_cpu() {
+	unsigned long long busy, total;
+	if (!parse_cpu(stat.buff, &busy, &total))
+		errx(1, "failed to parse `%s`", stat.path);
 
-	return speed;
-}
+	static unsigned long long old_busy, old_total;
+	unsigned long long delta_busy, delta_total;
 
-double get_fan2() {
-	const char* path = "/sys/class/hwmon/hwmon2/fan2_input";
-	static FILE* fan2_input;
-	open_or_die(path, &fan2_input);
+	delta_busy = busy - old_busy;
+	delta_total = total - old_total;
 
-	unsigned int speed;
-	if (fscanf(fan2_input, "%u", &speed) != 1)
-		errx(1, "failed to parse `%s`", path);
+	old_busy = busy;
+	old_total = total;
 
-	return speed;
+	return delta_total ? (double) delta_busy / delta_total : 0;
 }
 
-double get_fan3() {
-	const char* path = "/sys/class/hwmon/hwmon2/fan3_input";
-	static FILE* fan3_input;
-	open_or_die(path, &fan3_input);
+void get_cores(double* usage, double* freq) {
+	static unsigned long long busy[MAX_CORES], total[MAX_CORES];
+	static unsigned long long old_busy[MAX_CORES], old_total[MAX_CORES];
+	if (!parse_cores(stat.buff, core_ids, busy, total, core_count))
+		errx(1, "failed to parse `%s`", stat.path);
+
+	for (size_t i = 0; i < core_count; i++) {
+		unsigned long long delta_total = total[i] - old_total[i];
+		usage[i] = delta_total ? (double) (busy[i] - old_busy[i]) / delta_total : 0;
+		old_busy[i] = busy[i];
+		old_total[i] = total[i];
+
+		freq[i] = core_freqs && core_max_freqs[i] && !core_freqs[i].failed ?
+			parse_u64(core_freqs + i) / core_max_freqs[i] : 0;
+		if (freq[i] > 1)
+			freq[i] = 1;
+	}
+}
 
-	unsigned int speed;
-	if (fscanf(fan3_input, "%u", &speed) != 1)
-		errx(1, "failed to parse `%s`", path);
+double get_ram() {
+	unsigned long long total, available;
+	if (!parse_meminfo(meminfo.buff, &total, &available))
+		errx(1, "failed to parse `%s`", meminfo.path);
 
-	return speed;
+	return (double) (total - available) / total;
 }
 
-double get_enp4s0_rx() {
-	const char* path = "/sys/class/net/enp4s0/statistics/rx_bytes";
-	static FILE* rx_bytes;
-	open_or_die(path, &rx_bytes);
+// missing sensors read as zero
+double read_sensor(size_t index) {
+	unsigned long long value;
+	return get_sensor(sensors + index, &value) ? value : 0;
+}
 
-	unsigned long long bytes;
-	if (fscanf(rx_bytes, "%llu", &bytes) != 1)
-		errx(1, "failed to parse `%s`", path);
+double get_tccd1() {
+	return read_sensor(SENSOR_TCCD1) / 1000.0;
+}
 
-	static unsigned long long old_bytes;
-	unsigned long long delta = bytes - old_bytes;
-	old_bytes = bytes;
+double get_jc42() {
+	return read_sensor(SENSOR_JC42) / 1000.0;
+}
 
-	return delta;
+double get_fan1() {
+	return read_sensor(SENSOR_FAN1);
 }
 
-double get_enp4s0_tx() {
-	const char* path = "/sys/class/net/enp4s0/statistics/tx_bytes";
-	static FILE* tx_bytes;
-	open_or_die(path, &tx_bytes);
+double get_fan2() {
+	return read_sensor(SENSOR_FAN2);
+}
 
-	unsigned long long bytes;
-	if (fscanf(tx_bytes, "%llu", &bytes) != 1)
-		errx(1, "failed to parse `%s`", path);
+double get_fan3() {
+	return read_sensor(SENSOR_FAN3);
+}
 
-	static unsigned long long old_bytes;
-	unsigned long long delta = bytes - old_bytes;
-	old_bytes = bytes;
+// a counter and when its source was read
+struct Counter {
+	unsigned long long value;
+	double time;
+};
 
-	return delta;
+// per second change of the counter since the previous sample of its source
+double update_counter(struct Counter* counter, unsigned long long value, double time) {
+	double rate = (value - counter->value) / (time - counter->time);
+	counter->value = value;
+	counter->time = time;
+	return rate;
 }
 
 double get_uptime() {
-	const char* path = "/proc/uptime";
-	static FILE* uptime ;
-	open_or_die(path, &uptime);
-
+	const char* text = uptime.buff;
 	double time;
-	if (fscanf(uptime, "%lf", &time) != 1)
-		errx(1, "failed to parse `%s`", path);
+	if (!scan_decimal(&text, &time))
+		errx(1, "failed to parse `%s`", uptime.path);
 
 	return time;
 }
 
 void get_disk(double* read, double* written) {
-	static const char* paths[] = {
-		"/sys/block/sda/stat",
-		"/sys/block/sdb/stat",
-	};
-
-	static double old_read_total, old_written_total;
-	double read_total = 0, written_total = 0;
-	static FILE* disks[sizeof(paths) / sizeof(*paths)];
-	for (size_t i = 0; i < sizeof(paths) / sizeof(*paths); i++) {
-		open_or_die(paths[i], disks + i);
-
-		unsigned long long read, written;
-		if (fscanf(disks[i], "%*u %*u %llu %*u %*u %*u %llu", &read, &written) != 2)
-			errx(1, "failed to parse `%s`", paths[i]);
-
-		read_total += read;
-		written_total += written;
+	static struct Counter sectors_read[sizeof(disks) / sizeof(*disks)];
+	static struct Counter sectors_written[sizeof(disks) / sizeof(*disks)];
+	*read = *written = 0;
+	for (size_t i = 0; i < sizeof(disks) / sizeof(*disks); i++) {
+		unsigned long long r, w;
+		if (!parse_disk(disks[i].buff, &r, &w))
+			errx(1, "failed to parse `%s`", disks[i].path);
+
+		// sector size is independent of the actual disk
+		*read += update_counter(sectors_read + i, r, disks[i].time) * 512;
+		*written += update_counter(sectors_written + i, w, disks[i].time) * 512;
 	}
-
-	// sector size is independent of the actual disk
-	*read = (read_total - old_read_total) * 512;
-	*written = (written_total - old_written_total) * 512;
-	old_read_total = read_total;
-	old_written_total = written_total;
-}
-
-
-struct Stats {
-	double cpu;
-	double ram;
-	double cpu_tmp;
-	double ram_tmp;
-	double minutes;
-	double hours;
-	double days;
-	double fan1;
-	double fan2;
-	double fan3;
-	double net_rx;
-	double net_tx;
-	double disk_r;
-	double disk_w;
-};
+}
 
 // some stats are calcuated for the time perid between successive calls
 // therefore it returns garbage on the first run
 struct Stats get_stats() {
-	static double old_time;
-	double time = get_time();
-	double delta = time - old_time;
-	old_time = time;
+	if (!batch.sources)
+		init_stats();
+	read_batch(&batch);
+	check_sensors();
+	check_cores();
+	update_links(&links);
 
 	struct Stats stats = {
 		.cpu = get_cpu(),
@@ -232,13 +414,23 @@ struct Stats get_stats() {
 		.fan1 = get_fan1(),
 		.fan2 = get_fan2(),
 		.fan3 = get_fan3(),
-		.net_rx = get_enp4s0_rx() / delta,
-		.net_tx = get_enp4s0_tx() / delta,
+		.net_rx = links.rx,
+		.net_tx = links.tx,
 	};
 
+	stats.links = 0;
+	double traffic = links.rx + links.tx;
+	for (size_t i = 0; i < links.count; i++) {
+		const struct Link* link = links.links + i;
+		if (!link->counted)
+			continue;
+		stats.link_traffic[stats.links++] = traffic > 0 ? fmin((link->rx + link->tx) / traffic, 1) : 0;
+	}
+
+	stats.cores = core_count;
+	get_cores(stats.core_usage, stats.core_freq);
+
 	get_disk(&stats.disk_r, &stats.disk_w);
-	stats.disk_r /= delta;
-	stats.disk_w /= delta;
 
 	double uptime = get_uptime();
 	stats.minutes = fmod(uptime / 60, 60);
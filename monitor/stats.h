@@ -1,6 +1,14 @@
 #ifndef STATS_H
 #define STATS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "links.h"
+
+// cores past it are ignored
+#define MAX_CORES 512
+
 struct Stats {
 	double cpu;
 	double ram;
@@ -12,14 +20,47 @@ struct Stats {
 	double fan1;
 	double fan2;
 	double fan3;
+	// of the counted interfaces, see struct Link
 	double net_rx;
 	double net_tx;
 	double disk_r;
 	double disk_w;
+	// in the order of the ids of the present cores, which may have gaps
+	size_t cores;
+	double core_usage[MAX_CORES];
+	// relative to the maximum frequency of the core, zero without cpufreq
+	double core_freq[MAX_CORES];
+	// of the counted interfaces in the order of their indexes,
+	// the fraction of net_rx + net_tx that went through each
+	size_t links;
+	double link_traffic[MAX_INTERFACES];
 };
 
 // some stats are calcuated for the time perid between successive calls
 // therefore it returns garbage on the first run
 struct Stats get_stats();
 
+// parsers of the raw files, the text must be null terminated
+
+bool parse_cpu(const char* text, unsigned long long* busy, unsigned long long* total);
+
+// fills times of the cores found in the cpuN lines, the times of ids[i] go to
+// busy[i] and total[i], ids must be ascending like the lines, cores missing
+// from the text, e.g. offline ones, are left untouched
+bool parse_cores(
+		const char* text,
+		const unsigned* ids,
+		unsigned long long* busy,
+		unsigned long long* total,
+		size_t count
+);
+
+// the ids in a list of ranges like "0-3,6" in ascending order,
+// at most max of them, returns their number, 0 if the list is malformed
+size_t parse_core_list(const char* text, unsigned* ids, size_t max);
+
+bool parse_meminfo(const char* text, unsigned long long* total, unsigned long long* available);
+
+bool parse_disk(const char* text, unsigned long long* read, unsigned long long* written);
+
 #endif
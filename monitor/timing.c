@@ -3,10 +3,24 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 
 #include "timing.h"
 
+static bool virtual_clock;
+static double virtual_time;
+
+void use_virtual_clock() {
+	virtual_clock = true;
+	virtual_time = 0;
+}
+
 double get_time() {
+	if (virtual_clock)
+		return virtual_time;
+
 	struct timespec now;
 	if (clock_gettime(CLOCK_MONOTONIC, &now))
 		err(1, "clock_gettime failed");
@@ -14,6 +28,13 @@ double get_time() {
 }
 
 bool sleep_until(double target) {
+	if (virtual_clock) {
+		if (target <= virtual_time)
+			return false;
+		virtual_time = target;
+		return true;
+	}
+
 	target -= get_time();
 	if (target <= 0)
 		return false;
@@ -35,3 +56,76 @@ bool sleep_until(double target) {
 	}
 	return true;
 }
+
+void init_timer(struct Timer* timer, double rate) {
+	if (virtual_clock) {
+		timer->fd = -1;
+		timer->period = 1 / rate;
+		timer->expired = 0;
+		timer->next = virtual_time + timer->period;
+		return;
+	}
+
+	timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	if (timer->fd == -1)
+		err(1, "timerfd_create failed");
+	timer->period = 1 / rate;
+	timer->expired = 0;
+
+	double first = get_time() + timer->period;
+	struct itimerspec spec = {
+		.it_interval = {
+			.tv_sec = timer->period,
+			.tv_nsec = fmod(timer->period, 1) * 1e9,
+		},
+		.it_value = {
+			.tv_sec = first,
+			.tv_nsec = fmod(first, 1) * 1e9,
+		},
+	};
+	if (timerfd_settime(timer->fd, TFD_TIMER_ABSTIME, &spec, NULL))
+		err(1, "timerfd_settime failed");
+}
+
+// jumps to the earliest deadline
+void wait_virtual_timers(struct Timer** timers, size_t count) {
+	double next = timers[0]->next;
+	for (size_t i = 1; i < count; i++)
+		if (timers[i]->next < next)
+			next = timers[i]->next;
+	if (next > virtual_time)
+		virtual_time = next;
+
+	for (size_t i = 0; i < count; i++)
+		for (timers[i]->expired = 0; timers[i]->next <= virtual_time; timers[i]->expired++)
+			timers[i]->next += timers[i]->period;
+}
+
+void wait_timers(struct Timer** timers, size_t count) {
+	if (virtual_clock) {
+		wait_virtual_timers(timers, count);
+		return;
+	}
+
+	struct pollfd fds[count];
+	for (size_t i = 0; i < count; i++) {
+		fds[i].fd = timers[i]->fd;
+		fds[i].events = POLLIN;
+		timers[i]->expired = 0;
+	}
+
+	for (;;) {
+		int code = poll(fds, count, -1);
+		if (code > 0)
+			break;
+		if (code == -1 && errno != EINTR)
+			err(1, "poll failed");
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (!(fds[i].revents & POLLIN))
+			continue;
+		if (read(fds[i].fd, &timers[i]->expired, sizeof(uint64_t)) == -1 && errno != EAGAIN)
+			err(1, "failed to read timerfd");
+	}
+}
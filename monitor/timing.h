@@ -2,9 +2,34 @@
 #define TIMING_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 double get_time();
 
 bool sleep_until(double target);
 
+// from now on the clock starts at 0 and only moves when sleep_until() or
+// wait_timers() is called, which return at once, it's used for replays
+// and isn't meant for more than one thread
+void use_virtual_clock();
+
+// periodic timerfd, the kernel keeps the deadlines absolute,
+// so late wakeups don't shift the following ones
+struct Timer {
+	int fd;
+	double period;
+	// expirations since the last wait, more than one means some were missed
+	uint64_t expired;
+	// deadline on the virtual clock
+	double next;
+};
+
+void init_timer(struct Timer* timer, double rate);
+
+// since the program will never stop and free it's resources, there is no free_timer()
+
+// waits until at least one of the timers expires
+void wait_timers(struct Timer** timers, size_t count);
+
 #endif
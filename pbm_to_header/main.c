@@ -1,51 +1,101 @@
+#include <ctype.h>
 #include <err.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "pbm.h"
 
-int main(int argc, const char** argv) { 
-	if (argc != 4)
-		errx(1, "usage: %s pbm_path array_path array_name", argc > 0 ? argv[0] : "pbm_to_array");
+void usage(const char* name) {
+	errx(
+		1,
+		"usage: %s pbm_path array_path array_name\n"
+		"       %s -a header_path pbm_path...",
+		name, name
+	);
+}
 
-	const char* pbm_path = argv[1];
-	const char* array_path = argv[2];
-	const char* array_name = argv[3];
+// bytes are written 16 per line
+void write_bytes(FILE* output, const char* path, const unsigned char* bytes, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		if (fprintf(output, i % 16 == 0 ? "\t0x%02hhx," : " 0x%02hhx,", bytes[i]) < 1)
+			err(1, "failed to write to `%s`", path);
+		if ((i % 16 == 15 || i == len - 1) && fputc('\n', output) == EOF)
+			err(1, "failed to write to `%s`", path);
+	}
+}
 
+// the error image of uart_to_ssd1306, prefixed with the ssd1306 data control byte
+void write_firmware(const char* pbm_path, const char* array_path, const char* array_name) {
 	struct Bitmap pbm = load_pbm(pbm_path);
+	unsigned char packed[PACKED_SIZE(pbm.width, pbm.height)];
+	pack_pbm(&pbm, packed);
+
 	FILE* output = fopen(array_path, "w");
 	if (!output)
 		err(1, "failed to open `%s`", array_path);
 
 	if (fprintf(output, "const unsigned char %s[] = {\n\t0x40,\n", array_name) < 1)
 		err(1, "failed to write to `%s`", array_path);
-
-	size_t i = 0;
-	unsigned char byte = 0;
-	for (size_t y = 0; y < pbm.height; y++)
-		for (size_t x = 0; x < pbm.width; x++) {
-			byte |= pbm.buff[i % 8 + i / 8 / pbm.width * 8][i / 8 % pbm.width] << i % 8;
-
-			i++;
-			if (i % 8 == 0) {
-				if (i % 128 == 0) {
-					if (fprintf(output, "0x%02hhx,\n", byte) < 1)
-						err(1, "failed to write to `%s`", array_path);
-				} else if (i / 8 % 16 == 1) {
-					if (fprintf(output, "\t0x%02hhx, ", byte) < 1)
-						err(1, "failed to write to `%s`", array_path);
-				} else {
-					if (fprintf(output, "0x%02hhx, ", byte) < 1)
-						err(1, "failed to write to `%s`", array_path);
-				}
-				byte = 0;
-			}
-		}
-
+	write_bytes(output, array_path, packed, sizeof(packed));
 	if (fprintf(output, "};") < 1)
 		err(1, "failed to write to `%s`", array_path);
 
-
 	// it isn't necessary, but just to be sure
 	fclose(output);
 	free_pbm(&pbm);
 }
+
+// images built into the monitor, each one is named after its file,
+// e.g. "bitmaps/kibs.pbm" becomes asset_kibs of ASSET_KIBS_WIDTH by ASSET_KIBS_HEIGHT
+void write_assets(const char* header_path, const char** pbm_paths, size_t count) {
+	FILE* output = fopen(header_path, "w");
+	if (!output)
+		err(1, "failed to open `%s`", header_path);
+
+	if (fprintf(output, "// generated by pbm_to_header, packed like monitor/area.h\n") < 1)
+		err(1, "failed to write to `%s`", header_path);
+
+	for (size_t i = 0; i < count; i++) {
+		const char* slash = strrchr(pbm_paths[i], '/');
+		const char* base = slash ? slash + 1 : pbm_paths[i];
+		size_t name_len = strcspn(base, ".");
+		char name[name_len + 1], upper[name_len + 1];
+		for (size_t c = 0; c < name_len; c++) {
+			name[c] = isalnum((unsigned char)base[c]) ? base[c] : '_';
+			upper[c] = toupper((unsigned char)name[c]);
+		}
+		name[name_len] = upper[name_len] = '\0';
+
+		struct Bitmap pbm = load_pbm(pbm_paths[i]);
+		unsigned char packed[PACKED_SIZE(pbm.width, pbm.height)];
+		pack_pbm(&pbm, packed);
+
+		if (fprintf(
+				output,
+				"\n#define ASSET_%s_WIDTH %zu\n#define ASSET_%s_HEIGHT %zu\n"
+				"static const unsigned char asset_%s[] = {\n",
+				upper, pbm.width, upper, pbm.height, name
+		) < 1)
+			err(1, "failed to write to `%s`", header_path);
+		write_bytes(output, header_path, packed, sizeof(packed));
+		if (fprintf(output, "};\n") < 1)
+			err(1, "failed to write to `%s`", header_path);
+
+		free_pbm(&pbm);
+	}
+
+	if (fclose(output))
+		err(1, "failed to write to `%s`", header_path);
+}
+
+int main(int argc, const char** argv) {
+	const char* name = argc > 0 ? argv[0] : "pbm_to_header";
+
+	if (argc >= 3 && !strcmp(argv[1], "-a"))
+		write_assets(argv[2], argv + 3, argc - 3);
+	else if (argc == 4)
+		write_firmware(argv[1], argv[2], argv[3]);
+	else
+		usage(name);
+}
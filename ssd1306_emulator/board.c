@@ -0,0 +1,209 @@
+#include <stdio.h>
+
+#include "board.h"
+#include "error_img.h"
+
+// the display is the only thing on twi, see SSD1306_ADDR in the firmware,
+// start, address and stop take about a byte each
+void send_board(struct Board* board, const unsigned char* data, size_t len) {
+	start_ssd1306(&board->ssd1306);
+	for (size_t i = 0; i < len; i++)
+		write_ssd1306(&board->ssd1306, data[i]);
+	board->busy_until += (len + 3) * board->twi_time;
+	board->twi_bytes += len + 3;
+}
+
+void start_window_board(struct Board* board) {
+	const unsigned char window_sequence[] = {
+		0x00,
+		0x21, board->window[0], board->window[1],
+		0x22, board->window[2], board->window[3],
+	};
+	send_board(board, window_sequence, sizeof(window_sequence));
+
+	// the data transaction is left open until the window is filled
+	start_ssd1306(&board->ssd1306);
+	write_ssd1306(&board->ssd1306, 0x40);
+	board->busy_until += 3 * board->twi_time;
+	board->twi_bytes += 3;
+}
+
+void data_board(struct Board* board, unsigned char data) {
+	write_ssd1306(&board->ssd1306, data);
+	board->busy_until += board->twi_time;
+	board->twi_bytes++;
+}
+
+void stop_board(struct Board* board) {
+	board->busy_until += board->twi_time;
+	board->twi_bytes++;
+}
+
+void print_board(struct Board* board, const char* format, size_t value) {
+	size_t free = sizeof(board->output) - board->output_len;
+	int len = snprintf(board->output + board->output_len, free, format, value);
+	if (len > 0 && (size_t)len < free)
+		board->output_len += len;
+}
+
+void error_board(struct Board* board, const char* msg) {
+	board->error = msg;
+
+	const unsigned char error_sequence[] = {
+		0x00,
+		0x21, 0x00, 0x7f,
+		0x22, 0x00, 0x07,
+		0xD5, 0x00,
+		0x81, 0xFF,
+	};
+	send_board(board, error_sequence, sizeof(error_sequence));
+	send_board(board, error_img, sizeof(error_img));
+}
+
+void reset_board(struct Board* board, double twi_hz, double now) {
+	init_ssd1306(&board->ssd1306);
+	// nine clocks per byte with the acknowledgement
+	board->twi_time = 9 / twi_hz;
+	board->busy_until = now;
+	board->received = 0;
+	board->drained = 0;
+	board->rx_max = 0;
+	board->rx_reported = 0;
+	board->last_frame = now;
+	board->step = STEP_COMMAND;
+	board->error = NULL;
+	board->output_len = 0;
+	board->frames = 0;
+	board->twi_bytes = 0;
+
+	const unsigned char init_sequence[] = {
+		0x00,
+		0xAE,
+		0xA6,
+		0xA1,
+		0xC8,
+		0x81, 0x00,
+		0xD5, 0xF0,
+		0x20, 0x00,
+		0x8D, 0x14,
+		0x21, 0x00, 0x7f,
+		0x22, 0x00, 0x07,
+		0xAF,
+	};
+	send_board(board, init_sequence, sizeof(init_sequence));
+
+	// test pattern
+	board->window[0] = 0;
+	board->window[1] = DISPLAY_WIDTH - 1;
+	board->window[2] = 0;
+	board->window[3] = DISPLAY_PAGES - 1;
+	start_window_board(board);
+	for (int i = 0; i < DISPLAY_WIDTH * DISPLAY_PAGES; i++)
+		data_board(board, i);
+	stop_board(board);
+}
+
+// the byte waits in the receive buffer until the main loop is done
+// with the ones before it
+void take_board(struct Board* board, double now) {
+	while (board->drained < board->received && board->taken[board->drained % RX_SIZE] <= now)
+		board->drained++;
+
+	size_t used = board->received - board->drained;
+	if (used == RX_SIZE - 1) {
+		error_board(board, "receive buffer overflow");
+		return;
+	}
+	if (used + 1 > board->rx_max)
+		board->rx_max = used + 1;
+
+	if (board->busy_until < now)
+		board->busy_until = now;
+	board->taken[board->received++ % RX_SIZE] = board->busy_until;
+}
+
+void command_board(struct Board* board, unsigned char command) {
+	if (command == CMD_WINDOW || command == CMD_WINDOW_RLE) {
+		board->step = STEP_WINDOW;
+		board->rle = command == CMD_WINDOW_RLE;
+		board->window_len = 0;
+	} else if (command == CMD_HELLO) {
+		print_board(board, "hello %zu rle\n", RX_SIZE - 1);
+	} else if (command == CMD_FRAME) {
+		board->last_frame = board->busy_until;
+		board->frames++;
+		if (board->rx_max != board->rx_reported) {
+			board->rx_reported = board->rx_max;
+			print_board(board, "rx_max %zu\n", board->rx_max);
+		}
+	} else {
+		error_board(board, "invalid command");
+	}
+}
+
+void window_board(struct Board* board, unsigned char byte) {
+	board->window[board->window_len++] = byte;
+	if (board->window_len < 4)
+		return;
+
+	const unsigned char* w = board->window;
+	if (w[0] > w[1] || w[1] >= DISPLAY_WIDTH || w[2] > w[3] || w[3] >= DISPLAY_PAGES) {
+		error_board(board, "invalid window");
+		return;
+	}
+
+	start_window_board(board);
+	board->left = (size_t)(w[1] - w[0] + 1) * (w[3] - w[2] + 1);
+	board->step = board->rle ? STEP_RLE_CONTROL : STEP_RAW;
+}
+
+void receive_board(struct Board* board, unsigned char byte, double now) {
+	if (board->error)
+		return;
+	take_board(board, now);
+	if (board->error)
+		return;
+
+	switch (board->step) {
+	case STEP_COMMAND:
+		command_board(board, byte);
+		break;
+	case STEP_WINDOW:
+		window_board(board, byte);
+		break;
+	case STEP_RAW:
+		data_board(board, byte);
+		board->left--;
+		break;
+	case STEP_RLE_CONTROL:
+		board->run = (byte & 0x7F) + 1;
+		if (board->run > board->left) {
+			error_board(board, "invalid rle run");
+			return;
+		}
+		board->left -= board->run;
+		board->step = byte & 0x80 ? STEP_RLE_REPEAT : STEP_RLE_LITERAL;
+		break;
+	case STEP_RLE_REPEAT:
+		while (board->run--)
+			data_board(board, byte);
+		board->step = STEP_RLE_CONTROL;
+		break;
+	case STEP_RLE_LITERAL:
+		data_board(board, byte);
+		if (--board->run)
+			return;
+		board->step = STEP_RLE_CONTROL;
+		break;
+	}
+
+	if ((board->step == STEP_RAW || board->step == STEP_RLE_CONTROL) && !board->left) {
+		stop_board(board);
+		board->step = STEP_COMMAND;
+	}
+}
+
+void watch_board(struct Board* board, double now) {
+	if (!board->error && now - board->last_frame > WATCHDOG_TIMEOUT)
+		error_board(board, "timed out");
+}
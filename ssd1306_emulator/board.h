@@ -0,0 +1,66 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ssd1306.h"
+
+// same as in uart_to_ssd1306
+#define RX_SIZE 256
+#define WATCHDOG_TIMEOUT 4.0
+
+enum Step {
+	STEP_COMMAND,
+	STEP_WINDOW,
+	STEP_RAW,
+	STEP_RLE_CONTROL,
+	STEP_RLE_REPEAT,
+	STEP_RLE_LITERAL,
+};
+
+// uart_to_ssd1306 driven byte by byte, times are in seconds of a clock
+// the caller chooses, bytes have to arrive in order
+struct Board {
+	struct Ssd1306 ssd1306;
+	// duration of a byte on twi, start and stop conditions count as one
+	double twi_time;
+
+	// when the main loop is done with everything it has read so far
+	double busy_until;
+	// when the main loop took the last RX_SIZE bytes out of the buffer,
+	// the ones after drained are still in it when the next byte arrives
+	double taken[RX_SIZE];
+	size_t received, drained;
+	size_t rx_max, rx_reported;
+	double last_frame;
+
+	enum Step step;
+	bool rle;
+	unsigned char window[4];
+	size_t window_len;
+	// bytes left in the window and in the current rle run
+	size_t left;
+	size_t run;
+
+	// message the board stopped on, NULL while it's running
+	const char* error;
+	// lines for the host
+	char output[64];
+	size_t output_len;
+
+	// since the last reset
+	size_t frames;
+	size_t twi_bytes;
+};
+
+// powers the board on at time now, it draws the test pattern like the firmware
+void reset_board(struct Board* board, double twi_hz, double now);
+
+// a byte received by the uart at time now
+void receive_board(struct Board* board, unsigned char byte, double now);
+
+// stops the board with the timeout error if it didn't see a frame in time
+void watch_board(struct Board* board, double now);
+
+#endif
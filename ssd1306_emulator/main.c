@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "pbm.h"
+
+// how often the board repeats the error and the statistics are printed
+#define ERROR_PERIOD 0.01
+#define REPORT_PERIOD 1.0
+// bytes taken from the pty at once, the rest waits in the kernel,
+// so the host is slowed down by its writes like with a real uart
+#define CHUNK 64
+
+void usage(const char* name) {
+	errx(
+		1,
+		"usage: %s [-b baud] [-t twi_hz] [-l link_path] [-o pbm_path]",
+		name ? name : "ssd1306_emulator"
+	);
+}
+
+double get_time() {
+	struct timespec now;
+	if (clock_gettime(CLOCK_MONOTONIC, &now))
+		err(1, "clock_gettime failed");
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void sleep_until(double target) {
+	struct timespec until = {
+		.tv_sec = target,
+		.tv_nsec = fmod(target, 1) * 1e9,
+	};
+	int code;
+	while ((code = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL)) == EINTR);
+	if (code)
+		errx(1, "clock_nanosleep failed");
+}
+
+double parse_number(const char* arg, const char* name) {
+	char* end;
+	double number = strtod(arg, &end);
+	if (end == arg || *end || !(number > 0))
+		usage(name);
+	return number;
+}
+
+int open_pty(const char* link_path) {
+	int pty = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (pty == -1)
+		err(1, "failed to open pty");
+	if (grantpt(pty) || unlockpt(pty))
+		err(1, "failed to unlock pty");
+
+	const char* path = ptsname(pty);
+	if (!path)
+		err(1, "failed to get pty name");
+
+	if (link_path) {
+		if (unlink(link_path) && errno != ENOENT)
+			err(1, "failed to remove `%s`", link_path);
+		if (symlink(path, link_path))
+			err(1, "failed to link `%s` to `%s`", link_path, path);
+		path = link_path;
+	}
+	printf("%s\n", path);
+	fflush(stdout);
+	return pty;
+}
+
+// the host may not read, lines are dropped rather than waited for
+void write_pty(int pty, const char* buff, size_t len) {
+	if (write(pty, buff, len) == -1 && errno != EAGAIN && errno != EIO)
+		err(1, "failed to write to pty");
+}
+
+int main(int argc, char** argv) {
+	// the defaults are the ones of uart_to_ssd1306
+	double baud = 666666, twi_hz = 888888;
+	const char* link_path = NULL;
+	const char* pbm_path = NULL;
+
+	for (int opt; (opt = getopt(argc, argv, "b:t:l:o:")) != -1;) {
+		if (opt == 'b')
+			baud = parse_number(optarg, argv[0]);
+		else if (opt == 't')
+			twi_hz = parse_number(optarg, argv[0]);
+		else if (opt == 'l')
+			link_path = optarg;
+		else if (opt == 'o')
+			pbm_path = optarg;
+		else
+			usage(argv[0]);
+	}
+	if (optind != argc)
+		usage(argv[0]);
+
+	int pty = open_pty(link_path);
+
+	// start, eight data bits and stop
+	double byte_time = 10 / baud;
+
+	struct Board board;
+	bool connected = false;
+	// when the last byte taken from the pty is fully received
+	double uart_until = 0;
+	double next_error = 0, next_report = get_time() + REPORT_PERIOD;
+	size_t received = 0, frames = 0, twi_bytes = 0;
+
+	for (;;) {
+		struct pollfd pollfd = { .fd = pty, .events = POLLIN };
+		if (poll(&pollfd, 1, ERROR_PERIOD * 1000) == -1 && errno != EINTR)
+			err(1, "failed to poll pty");
+		double now = get_time();
+
+		// nobody has the other end open, the arduino resets when it's opened
+		if (pollfd.revents & POLLHUP) {
+			connected = false;
+			sleep_until(now + ERROR_PERIOD);
+			continue;
+		}
+		if (!connected) {
+			connected = true;
+			reset_board(&board, twi_hz, now);
+			uart_until = now;
+			next_error = now;
+			frames = 0;
+			twi_bytes = 0;
+			warnx("connected");
+		}
+
+		if (pollfd.revents & POLLIN) {
+			unsigned char chunk[CHUNK];
+			ssize_t r = read(pty, chunk, sizeof(chunk));
+			if (r == -1 && errno != EAGAIN && errno != EIO)
+				err(1, "failed to read from pty");
+
+			for (ssize_t i = 0; i < r; i++) {
+				uart_until = (uart_until > now ? uart_until : now) + byte_time;
+				receive_board(&board, chunk[i], uart_until);
+			}
+			received += r > 0 ? r : 0;
+
+			write_pty(pty, board.output, board.output_len);
+			board.output_len = 0;
+		}
+
+		watch_board(&board, now);
+		if (board.error && now >= next_error) {
+			char line[64];
+			int len = snprintf(line, sizeof(line), "%s\n", board.error);
+			write_pty(pty, line, len);
+			next_error = now + ERROR_PERIOD;
+		}
+
+		if (now >= next_report) {
+			warnx(
+				"%zu frames/s, %.0f%% uart, %.0f%% twi, rx_max %zu%s%s",
+				board.frames - frames,
+				(received * byte_time) / REPORT_PERIOD * 100,
+				(board.twi_bytes - twi_bytes) * board.twi_time / REPORT_PERIOD * 100,
+				board.rx_max,
+				board.error ? ", stopped on " : "",
+				board.error ? board.error : ""
+			);
+			frames = board.frames;
+			twi_bytes = board.twi_bytes;
+			received = 0;
+			// the memory as the monitor renders it, remapping and inversion are ignored
+			if (pbm_path)
+				save_frame_pbm(pbm_path, board.ssd1306.gddram, DISPLAY_WIDTH, DISPLAY_PAGES * 8);
+			next_report += REPORT_PERIOD;
+		}
+
+		// the uart doesn't take bytes faster than the baud rate
+		sleep_until(uart_until);
+	}
+}
@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include "ssd1306.h"
+
+void init_ssd1306(struct Ssd1306* ssd1306) {
+	memset(ssd1306->gddram, 0, sizeof(ssd1306->gddram));
+	ssd1306->mode = 2;
+	ssd1306->first_col = 0;
+	ssd1306->last_col = DISPLAY_WIDTH - 1;
+	ssd1306->first_page = 0;
+	ssd1306->last_page = DISPLAY_PAGES - 1;
+	ssd1306->col = 0;
+	ssd1306->page = 0;
+	ssd1306->start_col = 0;
+	ssd1306->on = false;
+	ssd1306->inverted = false;
+	ssd1306->contrast = 0x7F;
+	start_ssd1306(ssd1306);
+}
+
+void start_ssd1306(struct Ssd1306* ssd1306) {
+	ssd1306->control = true;
+	ssd1306->command_len = 0;
+}
+
+// bytes following the command byte
+size_t arguments_ssd1306(unsigned char command) {
+	switch (command) {
+	case 0x26: case 0x27: // horizontal scroll
+		return 6;
+	case 0x29: case 0x2A: // vertical and horizontal scroll
+		return 5;
+	case 0x21: case 0x22: case 0xA3: // column and page addresses, vertical scroll area
+		return 2;
+	case 0x20: case 0x81: case 0x8D: case 0xA8:
+	case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+void command_ssd1306(struct Ssd1306* ssd1306) {
+	const unsigned char* c = ssd1306->command;
+	if (c[0] == 0x20) {
+		ssd1306->mode = c[1] & 0x03;
+	} else if (c[0] == 0x21) {
+		ssd1306->first_col = c[1] & 0x7F;
+		ssd1306->last_col = c[2] & 0x7F;
+		ssd1306->col = ssd1306->first_col;
+	} else if (c[0] == 0x22) {
+		ssd1306->first_page = c[1] & 0x07;
+		ssd1306->last_page = c[2] & 0x07;
+		ssd1306->page = ssd1306->first_page;
+	} else if (c[0] <= 0x0F) {
+		// the page addressing commands are ignored in the other modes
+		ssd1306->start_col = (ssd1306->start_col & 0xF0) | c[0];
+		if (ssd1306->mode == 2)
+			ssd1306->col = ssd1306->start_col;
+	} else if (c[0] <= 0x1F) {
+		ssd1306->start_col = (ssd1306->start_col & 0x0F) | (c[0] & 0x07) << 4;
+		if (ssd1306->mode == 2)
+			ssd1306->col = ssd1306->start_col;
+	} else if ((c[0] & 0xF8) == 0xB0) {
+		if (ssd1306->mode == 2)
+			ssd1306->page = c[0] & 0x07;
+	} else if (c[0] == 0x81) {
+		ssd1306->contrast = c[1];
+	} else if ((c[0] & 0xFE) == 0xA6) {
+		ssd1306->inverted = c[0] & 1;
+	} else if ((c[0] & 0xFE) == 0xAE) {
+		ssd1306->on = c[0] & 1;
+	}
+}
+
+// moves to the next byte, the pointer wraps within the window
+// in horizontal and vertical modes and within the page in page mode
+void advance_ssd1306(struct Ssd1306* ssd1306) {
+	if (ssd1306->mode == 0) {
+		if (ssd1306->col++ < ssd1306->last_col)
+			return;
+		ssd1306->col = ssd1306->first_col;
+		if (ssd1306->page++ == ssd1306->last_page)
+			ssd1306->page = ssd1306->first_page;
+	} else if (ssd1306->mode == 1) {
+		if (ssd1306->page++ < ssd1306->last_page)
+			return;
+		ssd1306->page = ssd1306->first_page;
+		if (ssd1306->col++ == ssd1306->last_col)
+			ssd1306->col = ssd1306->first_col;
+	} else {
+		if (ssd1306->col++ == DISPLAY_WIDTH - 1)
+			ssd1306->col = ssd1306->start_col;
+	}
+}
+
+void write_ssd1306(struct Ssd1306* ssd1306, unsigned char byte) {
+	// continuation bit set means a single byte and another control byte
+	if (ssd1306->control) {
+		ssd1306->control = false;
+		ssd1306->data = byte & 0x40;
+		ssd1306->single = byte & 0x80;
+		return;
+	}
+	ssd1306->control = ssd1306->single;
+
+	if (ssd1306->data) {
+		ssd1306->gddram[ssd1306->page * DISPLAY_WIDTH + ssd1306->col] = byte;
+		advance_ssd1306(ssd1306);
+		return;
+	}
+
+	ssd1306->command[ssd1306->command_len++] = byte;
+	if (ssd1306->command_len <= arguments_ssd1306(ssd1306->command[0]))
+		return;
+	command_ssd1306(ssd1306);
+	ssd1306->command_len = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef SSD1306_H
+#define SSD1306_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "protocol.h"
+
+// the controller as seen over twi, only what affects the memory
+// and the way it's shown is modelled
+struct Ssd1306 {
+	unsigned char gddram[DISPLAY_PAGES * DISPLAY_WIDTH];
+
+	// 0 horizontal, 1 vertical, 2 page addressing
+	unsigned char mode;
+	unsigned char first_col, last_col, first_page, last_page;
+	// where the next data byte goes, in page addressing mode the column
+	// wraps to start_col
+	unsigned char col, page, start_col;
+
+	bool on;
+	bool inverted;
+	unsigned char contrast;
+
+	// the transaction begins with a control byte,
+	// commands are collected until all their arguments arrive
+	bool control;
+	bool data;
+	bool single;
+	unsigned char command[7];
+	size_t command_len;
+};
+
+// the state after power on
+void init_ssd1306(struct Ssd1306* ssd1306);
+
+// twi start condition followed by the address
+void start_ssd1306(struct Ssd1306* ssd1306);
+
+// every byte after the address until the stop condition
+void write_ssd1306(struct Ssd1306* ssd1306, unsigned char byte);
+
+#endif
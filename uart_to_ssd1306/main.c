@@ -10,11 +10,18 @@
 #include <util/twi.h>
 #include <util/delay.h>
 
+#include "protocol.h"
+
+// 2 is 666666 baud, 1 is 1M baud and 0 is 2M baud at double speed
+#ifndef UBRR
+#define UBRR 2
+#endif
+
 void init_uart() {
 	UCSR0A = 1<<U2X0; // double speed
-	UCSR0B = 1<<RXEN0 | 1<<TXEN0; // enable rx and tx
+	UCSR0B = 1<<RXCIE0 | 1<<RXEN0 | 1<<TXEN0; // enable rx interrupt, rx and tx
 	UCSR0C = 1<<UCSZ01 | 1<<UCSZ00; // async, no parity, one stop, 8-bit
-	UBRR0 = 2; // 666666 baud
+	UBRR0 = UBRR;
 }
 
 void write_uart(char c) {
@@ -27,6 +34,16 @@ void print_uart(const char* str) {
 		write_uart(*str++);
 }
 
+void print_uint_uart(unsigned int value) {
+	char digits[5];
+	size_t n = 0;
+	do
+		digits[n++] = '0' + value % 10;
+	while (value /= 10);
+	while (n)
+		write_uart(digits[--n]);
+}
+
 // called on TWI errors when display is dead
 void error_final(const char* msg) {
 	cli();
@@ -39,15 +56,71 @@ void error_final(const char* msg) {
 
 void error(const char* msg);
 
+// the uart only buffers two bytes, so every byte is moved here as soon
+// as it arrives, while the main loop waits for twi, the size must divide 256
+// it also absorbs the backlog of windows received faster than they pass
+// over twi, so the host keeps them within its size, see TWI_RATE
+#define RX_SIZE 256
+unsigned char rx_buff[RX_SIZE];
+volatile unsigned char rx_head, rx_tail;
+// worst occupancy so far and what was last reported to the host
+volatile unsigned char rx_max;
+unsigned char rx_reported;
+
+// interrupts don't fail themselves, since error() takes over twi, which may
+// be in the middle of a transfer, the main loop fails on its next read instead
+const char* volatile failure;
+
+void fail_uart(const char* msg) {
+	if (!failure)
+		failure = msg;
+	UCSR0B &= ~(1<<RXCIE0 | 1<<RXEN0); // nothing after it is trusted
+}
+
+ISR(USART_RX_vect) {
+	// the flags are of the byte in UDR0, reading it clears them
+	unsigned char status = UCSR0A;
+	unsigned char data = UDR0;
+	const char* msg =
+		status & 1<<FE0 ? "frame error" :
+		status & 1<<DOR0 ? "data overrun" :
+		status & 1<<UPE0 ? "parity error" : NULL;
+
+	unsigned char head = rx_head;
+	unsigned char used = head - rx_tail;
+	if (!msg && used == RX_SIZE - 1)
+		msg = "receive buffer overflow";
+	if (msg) {
+		fail_uart(msg);
+		return;
+	}
+	rx_buff[head % RX_SIZE] = data;
+	rx_head = head + 1;
+
+	if (used + 1 > rx_max)
+		rx_max = used + 1;
+}
+
 char read_uart() {
-	while (!(UCSR0A & 1<<RXC0));
-	if (UCSR0A & 1<<FE0)
-		error("frame error");
-	if (UCSR0A & 1<<DOR0)
-		error("data overrun");
-	if (UCSR0A & 1<<UPE0)
-		error("parity error");
-	return UDR0;
+	unsigned char tail = rx_tail;
+	while (rx_head == tail || failure)
+		if (failure)
+			error(failure);
+	char c = rx_buff[tail % RX_SIZE];
+	rx_tail = tail + 1;
+	return c;
+}
+
+// tells the host when the worst occupancy grows, see CMD_FRAME
+void report_uart() {
+	unsigned char max = rx_max;
+	if (max == rx_reported)
+		return;
+	rx_reported = max;
+
+	print_uart("rx_max ");
+	print_uint_uart(max);
+	print_uart("\n");
 }
 
 void init_twi() {
@@ -116,10 +189,29 @@ void invert_ssd1306(bool invert) {
 	send_twi(SSD1306_ADDR, flip_sequence, sizeof(flip_sequence));
 }
 
+// sets the window of the display memory the following data is written to
+void start_window(
+		unsigned char first_col,
+		unsigned char last_col,
+		unsigned char first_page,
+		unsigned char last_page
+) {
+	const unsigned char window_sequence[] = {
+		0x00, // the rest are commands
+		0x21, first_col, last_col,
+		0x22, first_page, last_page,
+	};
+	send_twi(SSD1306_ADDR, window_sequence, sizeof(window_sequence));
+
+	start_twi(SSD1306_ADDR);
+	data_twi(0b01000000); // the rest is data
+}
+
 #include "error_img.h"
 
 // called on regular errors
 void error(const char* msg) {
+	UCSR0B &= ~(1<<RXCIE0 | 1<<RXEN0); // stops receiving while waiting for twi
 	stop_twi();
 	const unsigned char error_sequence[] = {
 		0x00, // the rest are commands
@@ -155,7 +247,60 @@ void init_wdt() {
 }
 
 ISR(WDT_vect) {
-	error("timed out");
+	failure = "timed out";
+}
+
+// the window is validated before anything is sent to the display
+void read_window(size_t* len) {
+	unsigned char first_col = read_uart();
+	unsigned char last_col = read_uart();
+	unsigned char first_page = read_uart();
+	unsigned char last_page = read_uart();
+	if (
+		first_col > last_col || last_col >= DISPLAY_WIDTH ||
+		first_page > last_page || last_page >= DISPLAY_PAGES
+	)
+		error("invalid window");
+
+	start_window(first_col, last_col, first_page, last_page);
+	*len = (size_t)(last_col - first_col + 1) * (last_page - first_page + 1);
+}
+
+void read_raw_window() {
+	size_t len;
+	read_window(&len);
+	for (size_t i = 0; i < len; i++)
+		data_twi(read_uart());
+	stop_twi();
+}
+
+// decodes the runs straight into twi, see rle.h
+void read_rle_window() {
+	size_t len;
+	read_window(&len);
+	while (len) {
+		unsigned char control = read_uart();
+		unsigned char n = (control & 0x7F) + 1;
+		if (n > len)
+			error("invalid rle run");
+		len -= n;
+
+		if (control & 0x80) {
+			char data = read_uart();
+			while (n--)
+				data_twi(data);
+		} else {
+			while (n--)
+				data_twi(read_uart());
+		}
+	}
+	stop_twi();
+}
+
+void hello() {
+	print_uart("hello ");
+	print_uint_uart(RX_SIZE - 1);
+	print_uart(" rle\n");
 }
 
 int main() {
@@ -164,16 +309,25 @@ int main() {
 	init_ssd1306();
 	init_wdt();
 
-	// starting one long transmission
-	start_twi(SSD1306_ADDR);
-	data_twi(0b01000000);
-
 	// drawing test pattern
+	start_window(0, DISPLAY_WIDTH - 1, 0, DISPLAY_PAGES - 1);
 	for (int i = 0; i < 1024; i++)
 		data_twi(i);
+	stop_twi();
 
 	for(;;) {
-		data_twi(read_uart());
-		wdt_reset();
+		char command = read_uart();
+		if (command == CMD_WINDOW)
+			read_raw_window();
+		else if (command == CMD_WINDOW_RLE)
+			read_rle_window();
+		else if (command == CMD_HELLO)
+			hello();
+		else if (command == CMD_FRAME) {
+			wdt_reset();
+			report_uart();
+		}
+		else
+			error("invalid command");
 	}
 }